@@ -0,0 +1,303 @@
+//========================================================//
+//  alias.c                                               //
+//  Source file for the aliasing analyzer                 //
+//                                                        //
+//  Follows the table entries in the lookup records of    //
+//  every branch, one set of counters per table           //
+//========================================================//
+
+#include "alias.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Pairs in the set of a new table
+#define ALIAS_INITIAL 4096
+
+static const char* tageName[ALIAS_MAX_TABLES] = {
+    "base", "T1", "T2", "T3", "T4", "T5", "T6",
+    "T7",   "T8", "T9", "T10", "T11", "T12"};
+
+// An entry and its counters, for sorting
+typedef struct
+{
+    uint64_t conflicts;
+    uint32_t entry;
+} hot_t;
+
+static void init_table(alias_table_t* t, const char* name, uint64_t entries)
+{
+    memset(t, 0, sizeof(*t));
+    t->name = name;
+    if (entries > ALIAS_MAX_ENTRIES)
+    {
+        return;
+    }
+    t->entries = (uint32_t)entries;
+    t->last_pc = (uint32_t*)calloc(entries, sizeof(uint32_t));
+    t->accesses = (uint64_t*)calloc(entries, sizeof(uint64_t));
+    t->conflicts = (uint64_t*)calloc(entries, sizeof(uint64_t));
+    t->destructive = (uint64_t*)calloc(entries, sizeof(uint64_t));
+    t->distinct = (uint32_t*)calloc(entries, sizeof(uint32_t));
+    t->capacity = ALIAS_INITIAL;
+    t->seen = (uint64_t*)calloc(t->capacity, sizeof(uint64_t));
+}
+
+static void free_table(alias_table_t* t)
+{
+    free(t->last_pc);
+    free(t->accesses);
+    free(t->conflicts);
+    free(t->destructive);
+    free(t->distinct);
+    free(t->seen);
+}
+
+static inline uint64_t hash_key(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return key;
+}
+
+// Add 'key', never 0, to the set of 'table'
+//
+// Returns True if it was not in the set yet
+//
+static int insert_key(alias_table_t* t, uint64_t key)
+{
+    uint64_t mask = t->capacity - 1;
+    uint64_t slot = hash_key(key) & mask;
+    while (t->seen[slot] != 0)
+    {
+        if (t->seen[slot] == key)
+            return 0;
+        slot = (slot + 1) & mask;
+    }
+    t->seen[slot] = key;
+
+    // keep the set at most half full
+    if (++t->size * 2 > t->capacity)
+    {
+        uint64_t* old = t->seen;
+        uint64_t old_capacity = t->capacity;
+        t->capacity *= 2;
+        t->seen = (uint64_t*)calloc(t->capacity, sizeof(uint64_t));
+        mask = t->capacity - 1;
+        for (uint64_t s = 0; s < old_capacity; s++)
+        {
+            if (old[s] == 0)
+                continue;
+            slot = hash_key(old[s]) & mask;
+            while (t->seen[slot] != 0)
+                slot = (slot + 1) & mask;
+            t->seen[slot] = old[s];
+        }
+        free(old);
+    }
+    return 1;
+}
+
+// Count a use of 'entry' of 'table' by the branch at 'pc', which the
+// entry predicted as 'prediction'
+//
+static void use_entry(alias_table_t* t, uint32_t entry, uint32_t pc,
+                      uint8_t prediction, uint8_t outcome)
+{
+    if (t->entries == 0 || entry >= t->entries)
+    {
+        return;
+    }
+    if (t->accesses[entry]++ > 0 && t->last_pc[entry] != pc)
+    {
+        t->conflicts[entry]++;
+        t->destructive[entry] += prediction != outcome;
+    }
+    t->last_pc[entry] = pc;
+
+    // entries fit in 31 bits, the top bit keeps the key from being 0
+    uint64_t key = (1ULL << 63) | ((uint64_t)entry << 32) | pc;
+    t->distinct[entry] += insert_key(t, key);
+}
+
+alias_t* alias_create(const bp_config_t* cfgs, int num)
+{
+    alias_t* alias = (alias_t*)calloc(1, sizeof(alias_t));
+    alias->num_predictors = num;
+    alias->preds = (alias_pred_t*)calloc(num, sizeof(alias_pred_t));
+
+    for (int i = 0; i < num; i++)
+    {
+        alias_pred_t* ap = &alias->preds[i];
+        const bp_config_t* cfg = &cfgs[i];
+        alias_table_t* t = ap->tables;
+        ap->cfg = *cfg;
+
+        switch (cfg->bpType)
+        {
+        case GSHARE:
+            init_table(&t[ap->num_tables++], "BHT", 1ULL << cfg->ghistoryBits);
+            break;
+        case TOURNAMENT:
+        case CUSTOM:
+            init_table(&t[ap->num_tables++], "global BHT",
+                       1ULL << cfg->ghistoryBits);
+            init_table(&t[ap->num_tables++], "local BHT",
+                       1ULL << cfg->lhistoryBits);
+            init_table(&t[ap->num_tables++], "local PHT",
+                       1ULL << cfg->pcIndexBits);
+            break;
+        case TAGE:
+            init_table(&t[ap->num_tables++], tageName[0],
+                       4ULL << cfg->pcIndexBits);
+            for (int j = 1; j <= cfg->numTables; j++)
+            {
+                init_table(&t[ap->num_tables++], tageName[j],
+                           1ULL << cfg->pcIndexBits);
+            }
+            break;
+        case PERCEPTRON:
+            init_table(&t[ap->num_tables++], "weights", cfg->numRows);
+            break;
+        default:
+            break;
+        }
+    }
+
+    return alias;
+}
+
+void alias_destroy(alias_t* alias)
+{
+    for (int i = 0; i < alias->num_predictors; i++)
+    {
+        for (int j = 0; j < alias->preds[i].num_tables; j++)
+        {
+            free_table(&alias->preds[i].tables[j]);
+        }
+    }
+    free(alias->preds);
+    free(alias);
+}
+
+void alias_record(alias_t* alias, int i, uint32_t pc, const bp_lookup_t* rec,
+                  uint8_t outcome)
+{
+    alias_pred_t* ap = &alias->preds[i];
+    alias_table_t* t = ap->tables;
+
+    switch (ap->cfg.bpType)
+    {
+    case GSHARE:
+    case PERCEPTRON:
+        use_entry(&t[0], rec->index, pc, rec->base_pred, outcome);
+        break;
+    case TOURNAMENT:
+    case CUSTOM:
+        use_entry(&t[0], rec->index, pc, rec->global_pred, outcome);
+        use_entry(&t[1], rec->pat, pc, rec->local_pred, outcome);
+        // a local history is shared when the local prediction it
+        // selects is shared
+        use_entry(&t[2], rec->pc_idx, pc, rec->local_pred, outcome);
+        break;
+    case TAGE:
+        use_entry(&t[rec->provider], rec->index, pc, rec->provider_pred,
+                  outcome);
+        break;
+    default:
+        break;
+    }
+}
+
+static int compare_hot(const void* a, const void* b)
+{
+    const hot_t* x = (const hot_t*)a;
+    const hot_t* y = (const hot_t*)b;
+    if (x->conflicts != y->conflicts)
+        return x->conflicts < y->conflicts ? 1 : -1;
+    return x->entry < y->entry ? -1 : x->entry > y->entry;
+}
+
+void alias_report(const alias_t* alias, int top, FILE* out)
+{
+    for (int i = 0; i < alias->num_predictors; i++)
+    {
+        const alias_pred_t* ap = &alias->preds[i];
+        char name[64];
+        predictor_config_name(&ap->cfg, name, sizeof(name));
+        fprintf(out, "\nAliasing in %s\n", name);
+        if (ap->num_tables == 0)
+        {
+            fprintf(out, "  no tables\n");
+            continue;
+        }
+        fprintf(out, "%-12s %9s %7s %12s %9s %7s %11s %12s %12s\n", "Table",
+                "Entries", "Used %", "Accesses", "PCs/used", "Max PCs",
+                "Conflict %", "Constructive", "Destructive");
+
+        for (int j = 0; j < ap->num_tables; j++)
+        {
+            const alias_table_t* t = &ap->tables[j];
+            if (t->entries == 0)
+            {
+                fprintf(out, "%-12s %9s\n", t->name, "too large");
+                continue;
+            }
+
+            uint64_t used = 0, accesses = 0, conflicts = 0, destructive = 0;
+            uint32_t max_pcs = 0;
+            for (uint32_t e = 0; e < t->entries; e++)
+            {
+                used += t->accesses[e] > 0;
+                accesses += t->accesses[e];
+                conflicts += t->conflicts[e];
+                destructive += t->destructive[e];
+                max_pcs = t->distinct[e] > max_pcs ? t->distinct[e] : max_pcs;
+            }
+            fprintf(out, "%-12s %9u %7.2f %12llu %9.2f %7u %11.3f %12llu "
+                         "%12llu\n",
+                    t->name, t->entries, 100.0 * used / t->entries,
+                    (unsigned long long)accesses,
+                    used ? (double)t->size / used : 0.0, max_pcs,
+                    accesses ? 100.0 * conflicts / accesses : 0.0,
+                    (unsigned long long)(conflicts - destructive),
+                    (unsigned long long)destructive);
+        }
+
+        // The entries with the most conflicts
+        for (int j = 0; j < ap->num_tables && top > 0; j++)
+        {
+            const alias_table_t* t = &ap->tables[j];
+            hot_t* hot = (hot_t*)malloc((t->entries + 1) * sizeof(hot_t));
+            uint32_t count = 0;
+            for (uint32_t e = 0; e < t->entries; e++)
+            {
+                if (t->conflicts[e] > 0)
+                {
+                    hot[count].conflicts = t->conflicts[e];
+                    hot[count].entry = e;
+                    count++;
+                }
+            }
+            qsort(hot, count, sizeof(hot_t), compare_hot);
+
+            if (count > 0)
+            {
+                fprintf(out, "\nMost conflicted entries of the %s of %s\n",
+                        t->name, name);
+                fprintf(out, "%-10s %12s %12s %12s %7s\n", "Entry",
+                        "Accesses", "Conflicts", "Destructive", "PCs");
+            }
+            for (uint32_t h = 0; h < count && h < (uint32_t)top; h++)
+            {
+                uint32_t e = hot[h].entry;
+                fprintf(out, "%-10u %12llu %12llu %12llu %7u\n", e,
+                        (unsigned long long)t->accesses[e],
+                        (unsigned long long)t->conflicts[e],
+                        (unsigned long long)t->destructive[e],
+                        t->distinct[e]);
+            }
+            free(hot);
+        }
+    }
+}
@@ -0,0 +1,73 @@
+//========================================================//
+//  alias.h                                               //
+//  Header file for the aliasing analyzer                 //
+//                                                        //
+//  Tracks which branches share each table entry of the   //
+//  simulated predictors and how often that hurts         //
+//========================================================//
+
+#ifndef ALIAS_H
+#define ALIAS_H
+
+#include "predictor.h"
+#include "tage.h"
+#include <stdint.h>
+#include <stdio.h>
+
+// Most tables analyzed per predictor, the tage tables and its base
+#define ALIAS_MAX_TABLES (TAGE_MAX_TABLES + 1)
+
+// Largest table analyzed, larger ones are skipped
+#define ALIAS_MAX_ENTRIES (1 << 22)
+
+// Counters of one table, per entry. An access conflicts when the entry
+// was last used by another branch. A conflict is destructive when the
+// prediction read from the entry was wrong, and constructive otherwise.
+typedef struct
+{
+    const char* name;
+    uint32_t entries; // 0 when the table is too large
+    uint32_t* last_pc;
+    uint64_t* accesses;
+    uint64_t* conflicts;
+    uint64_t* destructive;
+    uint32_t* distinct; // distinct branches that used the entry
+
+    // the (entry, pc) pairs seen, in an open-addressing hash set
+    uint64_t* seen;
+    uint64_t capacity; // power of two
+    uint64_t size;
+} alias_table_t;
+
+typedef struct
+{
+    bp_config_t cfg;
+    int num_tables;
+    alias_table_t tables[ALIAS_MAX_TABLES];
+} alias_pred_t;
+
+typedef struct
+{
+    int num_predictors;
+    alias_pred_t* preds;
+} alias_t;
+
+// Create an analyzer of the 'num' predictors with the geometries in
+// 'cfgs'
+//
+alias_t* alias_create(const bp_config_t* cfgs, int num);
+
+void alias_destroy(alias_t* alias);
+
+// Record the table entries used by predictor 'i' for the branch at 'pc',
+// from its lookup record 'rec', and whether they predicted 'outcome'
+//
+void alias_record(alias_t* alias, int i, uint32_t pc, const bp_lookup_t* rec,
+                  uint8_t outcome);
+
+// Print the occupancy, sharing and interference of every table, and its
+// 'top' entries with the most conflicts
+//
+void alias_report(const alias_t* alias, int top, FILE* out);
+
+#endif
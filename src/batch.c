@@ -0,0 +1,152 @@
+//========================================================//
+//  batch.c                                               //
+//  Source file for the batch runner                      //
+//                                                        //
+//  Each trace is a job of the work-stealing pool, which  //
+//  loads it and runs every predictor over it             //
+//========================================================//
+
+#include "batch.h"
+#include "pool.h"
+#include "sim.h"
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    char** paths;
+    const bp_config_t* cfgs;
+    int num_cfgs;
+    uint64_t* num_branches;   // per trace
+    uint64_t* mispredictions; // per trace and predictor
+    int* ok;                  // per trace
+} batch_t;
+
+static void batch_job(void* arg, int job)
+{
+    batch_t* batch = (batch_t*)arg;
+    trace_mem_t mem;
+
+    if (!trace_load(&mem, batch->paths[job]))
+    {
+        return;
+    }
+
+    for (int i = 0; i < batch->num_cfgs; i++)
+    {
+        predictor_t* bp = predictor_create(&batch->cfgs[i]);
+        batch->mispredictions[job * batch->num_cfgs + i] = sim_run(bp, &mem);
+        predictor_destroy(bp);
+    }
+    batch->num_branches[job] = mem.num_branches;
+    batch->ok[job] = 1;
+
+    trace_unload(&mem);
+}
+
+// Get the name of a trace from its path, without directory or extension
+//
+static void trace_name(const char* path, char* buf, size_t len)
+{
+    const char* base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    snprintf(buf, len, "%s", base);
+
+    char* ext = strchr(buf, '.');
+    if (ext != NULL && ext != buf)
+    {
+        *ext = '\0';
+    }
+}
+
+static void print_row(FILE* out, const char* trace, int width,
+                      const char* predictor, uint64_t branches,
+                      uint64_t incorrect, double insts_per_branch)
+{
+    double rate = branches ? 100.0 * incorrect / branches : 0.0;
+    double insts = branches * insts_per_branch;
+    double mpki = insts > 0 ? 1000.0 * incorrect / insts : 0.0;
+
+    fprintf(out, "%-12s %-*s %12llu %12llu %9.3f %9.3f\n", trace, width,
+            predictor, (unsigned long long)branches,
+            (unsigned long long)incorrect, rate, mpki);
+}
+
+int batch_run(char** paths, int num_traces, const bp_config_t* cfgs,
+              int num_cfgs, int num_threads, double insts_per_branch,
+              FILE* out)
+{
+    batch_t batch;
+    batch.paths = paths;
+    batch.cfgs = cfgs;
+    batch.num_cfgs = num_cfgs;
+    batch.num_branches = (uint64_t*)calloc(num_traces, sizeof(uint64_t));
+    batch.mispredictions =
+        (uint64_t*)calloc(num_traces * num_cfgs, sizeof(uint64_t));
+    batch.ok = (int*)calloc(num_traces, sizeof(int));
+
+    pool_run(num_traces, num_threads, batch_job, &batch);
+
+    int width = predictor_name_width(cfgs, num_cfgs);
+    fprintf(out, "%-12s %-*s %12s %12s %9s %9s\n", "Trace", width,
+            "Predictor", "Branches", "Incorrect", "Rate", "MPKI");
+
+    int all_ok = 1;
+    for (int t = 0; t < num_traces; t++)
+    {
+        char name[64];
+        trace_name(paths[t], name, sizeof(name));
+        if (!batch.ok[t])
+        {
+            fprintf(out, "%-12s failed to read %s\n", name, paths[t]);
+            all_ok = 0;
+            continue;
+        }
+
+        for (int i = 0; i < num_cfgs; i++)
+        {
+            char cfg_name[64];
+            predictor_config_name(&cfgs[i], cfg_name, sizeof(cfg_name));
+            print_row(out, name, width, cfg_name, batch.num_branches[t],
+                      batch.mispredictions[t * num_cfgs + i],
+                      insts_per_branch);
+        }
+    }
+
+    // Totals over all traces, and the mean of the per-trace rates
+    for (int i = 0; i < num_cfgs; i++)
+    {
+        char cfg_name[64];
+        uint64_t branches = 0, incorrect = 0;
+        double rate_sum = 0.0, mpki_sum = 0.0;
+        int count = 0;
+
+        for (int t = 0; t < num_traces; t++)
+        {
+            if (!batch.ok[t] || batch.num_branches[t] == 0)
+                continue;
+            uint64_t miss = batch.mispredictions[t * num_cfgs + i];
+            branches += batch.num_branches[t];
+            incorrect += miss;
+            rate_sum += 100.0 * miss / batch.num_branches[t];
+            mpki_sum += 1000.0 * miss /
+                        (batch.num_branches[t] * insts_per_branch);
+            count++;
+        }
+
+        predictor_config_name(&cfgs[i], cfg_name, sizeof(cfg_name));
+        print_row(out, "Total", width, cfg_name, branches, incorrect,
+                  insts_per_branch);
+        if (count > 0)
+        {
+            fprintf(out, "%-12s %-*s %12s %12s %9.3f %9.3f\n", "Mean", width,
+                    cfg_name, "", "", rate_sum / count, mpki_sum / count);
+        }
+    }
+
+    free(batch.ok);
+    free(batch.mispredictions);
+    free(batch.num_branches);
+    return all_ok;
+}
@@ -0,0 +1,27 @@
+//========================================================//
+//  batch.h                                               //
+//  Header file for the batch runner                      //
+//                                                        //
+//  Evaluates predictors over many traces in parallel     //
+//========================================================//
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "predictor.h"
+#include <stdio.h>
+
+// Simulate every predictor in 'cfgs' over each of the 'num_traces'
+// traces, one trace per worker thread with the decoded trace held in
+// memory, and print the per-trace and aggregate results to 'out'.
+//
+// Traces only record conditional branches, so MPKI is computed from
+// 'insts_per_branch' instructions per branch.
+//
+// Returns True if every trace could be read
+//
+int batch_run(char** paths, int num_traces, const bp_config_t* cfgs,
+              int num_cfgs, int num_threads, double insts_per_branch,
+              FILE* out);
+
+#endif
@@ -0,0 +1,361 @@
+//========================================================//
+//  bench.c                                               //
+//  Throughput benchmark for the Branch Predictors        //
+//                                                        //
+//  Preloads a trace and times the predict and train loop //
+//  of each predictor separately from trace I/O           //
+//========================================================//
+
+#define _GNU_SOURCE
+#include "predictor.h"
+#include "sim.h"
+#include "trace.h"
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// Hardware events counted around the simulation loop
+#define NUM_EVENTS 3
+const char* eventName[NUM_EVENTS] = {"cycles", "instructions",
+                                     "cache_misses"};
+const uint64_t eventConfig[NUM_EVENTS] = {PERF_COUNT_HW_CPU_CYCLES,
+                                          PERF_COUNT_HW_INSTRUCTIONS,
+                                          PERF_COUNT_HW_CACHE_MISSES};
+
+typedef struct
+{
+    char trace[256];
+    char predictor[64];
+    uint64_t branches;
+    uint64_t mispredictions;
+    double load_sec;
+    double sim_sec;
+    int64_t events[NUM_EVENTS]; // -1 where the counter is unavailable
+} result_t;
+
+// Print out the Usage information to stderr
+//
+void usage()
+{
+    fprintf(stderr, "Usage: bench <options> <trace> [<trace>...]\n");
+    fprintf(stderr, " Options:\n");
+    fprintf(stderr, " --help            Print this message\n");
+    fprintf(stderr, " --<type>          Predictor to time, may be repeated\n"
+                    "                   (default: every type)\n");
+    fprintf(stderr, " --repeat <n>      Time each run n times, keep the best\n"
+                    "                   (default: 3)\n");
+    fprintf(stderr, " --out <file>      Write the results as CSV\n");
+    fprintf(stderr, " --label <name>    Label of this run in the CSV, e.g. a\n"
+                    "                   commit id\n");
+    fprintf(stderr, " --compare <file>  Compare against an earlier CSV\n");
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//------------------------------------//
+//        Hardware Counters           //
+//------------------------------------//
+
+// Open a counter for 'config' on this thread
+//
+// Returns the file descriptor, or -1 where perf events are unavailable
+//
+static int open_counter(uint64_t config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void start_counters(int* fds)
+{
+    for (int i = 0; i < NUM_EVENTS; i++)
+    {
+        if (fds[i] >= 0)
+        {
+            ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+static void stop_counters(int* fds, int64_t* events)
+{
+    for (int i = 0; i < NUM_EVENTS; i++)
+    {
+        uint64_t val;
+        events[i] = -1;
+        if (fds[i] >= 0)
+        {
+            ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fds[i], &val, sizeof(val)) == sizeof(val))
+            {
+                events[i] = (int64_t)val;
+            }
+        }
+    }
+}
+
+//------------------------------------//
+//           Result Files             //
+//------------------------------------//
+
+static void write_results(const char* path, const char* label,
+                          const result_t* res, int num_results)
+{
+    FILE* out = fopen(path, "w");
+    if (out == NULL)
+    {
+        perror(path);
+        return;
+    }
+
+    fprintf(out, "label,trace,predictor,branches,mispredictions,load_sec,"
+                 "sim_sec,branches_per_sec,ns_per_branch");
+    for (int e = 0; e < NUM_EVENTS; e++)
+    {
+        fprintf(out, ",%s", eventName[e]);
+    }
+    fprintf(out, "\n");
+
+    for (int i = 0; i < num_results; i++)
+    {
+        const result_t* r = &res[i];
+        fprintf(out, "%s,%s,%s,%llu,%llu,%.6f,%.6f,%.0f,%.3f", label,
+                r->trace, r->predictor, (unsigned long long)r->branches,
+                (unsigned long long)r->mispredictions, r->load_sec, r->sim_sec,
+                r->branches / r->sim_sec, 1e9 * r->sim_sec / r->branches);
+        for (int e = 0; e < NUM_EVENTS; e++)
+        {
+            fprintf(out, ",%lld", (long long)r->events[e]);
+        }
+        fprintf(out, "\n");
+    }
+
+    fclose(out);
+}
+
+// Print the change in ns/branch against the results in 'path'
+//
+static void compare_results(const char* path, const result_t* res,
+                            int num_results)
+{
+    FILE* in = fopen(path, "r");
+    if (in == NULL)
+    {
+        perror(path);
+        return;
+    }
+
+    printf("\n%-24s %-24s %10s %10s %8s\n", "Trace", "Predictor", "Old ns/br",
+           "New ns/br", "Speedup");
+
+    char line[1024];
+    while (fgets(line, sizeof(line), in))
+    {
+        char trace[256], predictor[64];
+        double ns;
+        // label,trace,predictor,branches,mispredictions,load,sim,bps,ns
+        if (sscanf(line, "%*[^,],%255[^,],%63[^,],%*[^,],%*[^,],%*[^,],"
+                         "%*[^,],%*[^,],%lf",
+                   trace, predictor, &ns) != 3)
+        {
+            continue;
+        }
+
+        for (int i = 0; i < num_results; i++)
+        {
+            const result_t* r = &res[i];
+            if (strcmp(r->trace, trace) || strcmp(r->predictor, predictor))
+                continue;
+
+            double new_ns = 1e9 * r->sim_sec / r->branches;
+            printf("%-24s %-24s %10.3f %10.3f %7.2fx%s\n", trace, predictor,
+                   ns, new_ns, ns / new_ns,
+                   ns / new_ns < 0.95 ? "  REGRESSION" : "");
+        }
+    }
+
+    fclose(in);
+}
+
+int main(int argc, char* argv[])
+{
+    bp_config_t cfgs[64];
+    int num_cfgs = 0;
+    char** traces = (char**)malloc(argc * sizeof(char*));
+    int num_traces = 0;
+    int repeat = 3;
+    const char* out_path = NULL;
+    const char* compare_path = NULL;
+    const char* label = "run";
+
+    // Process cmdline Arguments
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--help"))
+        {
+            usage();
+            exit(0);
+        }
+        else if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+        {
+            repeat = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--out") && i + 1 < argc)
+        {
+            out_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--label") && i + 1 < argc)
+        {
+            label = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--compare") && i + 1 < argc)
+        {
+            compare_path = argv[++i];
+        }
+        else if (!strncmp(argv[i], "--", 2) && num_cfgs < 64 &&
+                 predictor_parse_config(argv[i] + 2, &cfgs[num_cfgs]))
+        {
+            num_cfgs++;
+        }
+        else if (!strncmp(argv[i], "--", 2))
+        {
+            printf("Unrecognized option %s\n", argv[i]);
+            usage();
+            exit(1);
+        }
+        else
+        {
+            traces[num_traces++] = argv[i];
+        }
+    }
+
+    if (num_traces == 0)
+    {
+        usage();
+        exit(1);
+    }
+    if (num_cfgs == 0)
+    {
+        for (int t = STATIC; t < NUM_TYPES; t++)
+        {
+            predictor_default_config(&cfgs[num_cfgs++], t);
+        }
+    }
+    if (repeat < 1)
+    {
+        repeat = 1;
+    }
+
+    int fds[NUM_EVENTS];
+    for (int e = 0; e < NUM_EVENTS; e++)
+    {
+        fds[e] = open_counter(eventConfig[e]);
+    }
+
+    result_t* res = (result_t*)calloc(num_traces * num_cfgs, sizeof(result_t));
+    int num_results = 0;
+
+    printf("%-12s %-24s %12s %12s %10s %14s\n", "Trace", "Predictor",
+           "Load (s)", "Branches/s", "ns/branch", "Cache misses");
+
+    for (int t = 0; t < num_traces; t++)
+    {
+        trace_mem_t mem;
+        double start = now();
+        if (!trace_load(&mem, traces[t]) || mem.num_branches == 0)
+        {
+            fprintf(stderr, "Failed to load %s\n", traces[t]);
+            continue;
+        }
+        // fault in a mapped trace so page faults count as I/O
+        volatile uint64_t sink = 0;
+        for (uint64_t b = 0; b < mem.num_blocks; b++)
+        {
+            sink += mem.blocks[b].taken;
+        }
+        double load_sec = now() - start;
+
+        for (int c = 0; c < num_cfgs; c++)
+        {
+            result_t* r = &res[num_results++];
+            snprintf(r->trace, sizeof(r->trace), "%s", traces[t]);
+            predictor_config_name(&cfgs[c], r->predictor,
+                                  sizeof(r->predictor));
+            r->branches = mem.num_branches;
+            r->load_sec = load_sec;
+            r->sim_sec = -1;
+
+            // Keep the fastest of the repeated runs
+            for (int n = 0; n < repeat; n++)
+            {
+                int64_t events[NUM_EVENTS];
+                predictor_t* bp = predictor_create(&cfgs[c]);
+
+                start_counters(fds);
+                start = now();
+                uint64_t misses = sim_run(bp, &mem);
+                double sim_sec = now() - start;
+                stop_counters(fds, events);
+
+                predictor_destroy(bp);
+                if (r->sim_sec < 0 || sim_sec < r->sim_sec)
+                {
+                    r->sim_sec = sim_sec;
+                    r->mispredictions = misses;
+                    memcpy(r->events, events, sizeof(events));
+                }
+            }
+
+            char misses[32] = "n/a";
+            if (r->events[NUM_EVENTS - 1] >= 0)
+            {
+                snprintf(misses, sizeof(misses), "%lld",
+                         (long long)r->events[NUM_EVENTS - 1]);
+            }
+            printf("%-12.12s %-24s %12.3f %12.0f %10.3f %14s\n",
+                   strrchr(traces[t], '/') ? strrchr(traces[t], '/') + 1
+                                           : traces[t],
+                   r->predictor, r->load_sec, r->branches / r->sim_sec,
+                   1e9 * r->sim_sec / r->branches, misses);
+        }
+
+        trace_unload(&mem);
+    }
+
+    if (out_path)
+    {
+        write_results(out_path, label, res, num_results);
+    }
+    if (compare_path)
+    {
+        compare_results(compare_path, res, num_results);
+    }
+
+    for (int e = 0; e < NUM_EVENTS; e++)
+    {
+        if (fds[e] >= 0)
+            close(fds[e]);
+    }
+    free(res);
+    free(traces);
+    return 0;
+}
@@ -0,0 +1,156 @@
+//========================================================//
+//  corrector.c                                           //
+//  Source file for the statistical corrector             //
+//                                                        //
+//  The counters are trained like a GEHL predictor, with  //
+//  a threshold adapted on the predictions it overturns   //
+//========================================================//
+
+#include "corrector.h"
+#include "counters.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Global history used by each table, the bias table first
+static const int scHistory[SC_NUM_TABLES] = {0, 8, 16, 32};
+
+// Counters are stored unsigned, SC_ZERO standing for 0
+#define SC_ZERO (1u << (SC_CTR_BITS - 1))
+
+#define SC_INITIAL_THRESHOLD 12
+
+struct corrector
+{
+    int bits;
+    packed_t ctr[SC_NUM_TABLES];
+    uint64_t ghist;
+    uint32_t threshold;
+    uint32_t tc; // raises the threshold at its max, lowers it at 0
+
+    // Scratch record of the last lookup
+    uint32_t index[SC_NUM_TABLES];
+    int32_t sum;
+    uint8_t base;
+    int weak;
+};
+
+corrector_t* corrector_create(int bits)
+{
+    if (bits < SC_MIN_BITS || bits > SC_MAX_BITS)
+    {
+        return NULL;
+    }
+
+    corrector_t* c = (corrector_t*)calloc(1, sizeof(corrector_t));
+    c->bits = bits;
+    for (int j = 0; j < SC_NUM_TABLES; j++)
+    {
+        packed_init(&c->ctr[j], 1u << bits, SC_CTR_BITS);
+    }
+    corrector_reset(c);
+    return c;
+}
+
+void corrector_reset(corrector_t* c)
+{
+    for (int j = 0; j < SC_NUM_TABLES; j++)
+    {
+        packed_fill(&c->ctr[j], SC_ZERO);
+    }
+    c->ghist = 0;
+    c->threshold = SC_INITIAL_THRESHOLD;
+    c->tc = 1u << (SC_TC_BITS - 1);
+}
+
+// Get the entry of table 'j' for the branch at 'pc' predicted 'base'
+// with confidence 'weak' by the base predictor
+//
+static inline uint32_t sc_index(const corrector_t* c, int j, uint32_t pc,
+                                uint8_t base, int weak)
+{
+    uint64_t hist = c->ghist & ((1ULL << scHistory[j]) - 1);
+    uint64_t h = (((uint64_t)pc << 32) ^ hist ^ ((uint64_t)j << 60)) *
+                 0x9e3779b97f4a7c15ULL;
+    if (j == 0)
+    {
+        return (uint32_t)(h >> (66 - c->bits)) << 2 | base << 1 | weak;
+    }
+    return (uint32_t)(h >> (65 - c->bits)) << 1 | base;
+}
+
+uint8_t corrector_lookup(corrector_t* c, uint32_t pc, uint8_t base,
+                         int weak)
+{
+    int32_t sum = 0;
+    for (int j = 0; j < SC_NUM_TABLES; j++)
+    {
+        c->index[j] = sc_index(c, j, pc, base, weak != 0);
+        // centered on 0, as 2 * ctr + 1
+        sum += 2 * (int32_t)packed_get(&c->ctr[j], c->index[j]) -
+               (2 * SC_ZERO - 1);
+    }
+    c->sum = sum;
+    c->base = base;
+    c->weak = weak;
+
+    uint8_t pred = sum >= 0;
+    if (weak && pred != base && (uint32_t)abs(sum) >= c->threshold)
+    {
+        return pred;
+    }
+    return base;
+}
+
+void corrector_update(corrector_t* c, uint8_t outcome)
+{
+    uint8_t pred = c->sum >= 0;
+    uint32_t mag = (uint32_t)abs(c->sum);
+
+    // the threshold adapts on the predictions it could overturn, rising
+    // when the sum is wrong and falling when it is right but too small
+    if (c->weak && pred != c->base)
+    {
+        uint32_t max = (1u << SC_TC_BITS) - 1;
+        uint32_t mid = 1u << (SC_TC_BITS - 1);
+        if (pred != outcome && ++c->tc == max)
+        {
+            c->threshold += c->threshold < (1u << SC_THRESHOLD_BITS) - 1;
+            c->tc = mid;
+        }
+        else if (pred == outcome && mag < c->threshold && --c->tc == 0)
+        {
+            c->threshold -= c->threshold > 1;
+            c->tc = mid;
+        }
+    }
+
+    if (pred != outcome || mag < c->threshold)
+    {
+        for (int j = 0; j < SC_NUM_TABLES; j++)
+        {
+            packed_count(&c->ctr[j], c->index[j], outcome == TAKEN);
+        }
+    }
+
+    c->ghist = (c->ghist << 1) | (outcome & 0x1);
+}
+
+void corrector_state(corrector_t* c, bp_state_t* s)
+{
+    for (int j = 0; j < SC_NUM_TABLES; j++)
+    {
+        state_packed(s, &c->ctr[j]);
+    }
+    state_bytes(s, &c->ghist, sizeof(c->ghist));
+    state_bytes(s, &c->threshold, sizeof(c->threshold));
+    state_bytes(s, &c->tc, sizeof(c->tc));
+}
+
+void corrector_destroy(corrector_t* c)
+{
+    for (int j = 0; j < SC_NUM_TABLES; j++)
+    {
+        packed_free(&c->ctr[j]);
+    }
+    free(c);
+}
@@ -0,0 +1,64 @@
+//========================================================//
+//  corrector.h                                           //
+//  Header file for the statistical corrector             //
+//                                                        //
+//  Side predictor summing counters indexed by the PC,    //
+//  the base prediction and global histories to overturn  //
+//  base predictions made with low confidence             //
+//========================================================//
+
+#ifndef CORRECTOR_H
+#define CORRECTOR_H
+
+#include "predictor.h"
+#include "state.h"
+
+// Tables of counters: a bias table indexed by the PC and the base
+// prediction, then tables with growing lengths of global history
+#define SC_NUM_TABLES 4
+
+// Limits of the log2 number of entries per table
+#define SC_MIN_BITS     4
+#define SC_MAX_BITS     20
+#define SC_DEFAULT_BITS 10
+
+// Widths of the counters and registers
+#define SC_CTR_BITS       6  // signed counter, stored with an offset
+#define SC_HISTORY_BITS   32 // global history, the longest table's
+#define SC_THRESHOLD_BITS 8  // sum needed to overturn the base
+#define SC_TC_BITS        6  // counter adapting the threshold
+
+typedef struct corrector corrector_t;
+
+// Create a statistical corrector with tables of 2^bits counters
+//
+// Returns NULL if 'bits' is out of range
+//
+corrector_t* corrector_create(int bits);
+
+// Return the corrector to its initial state
+//
+void corrector_reset(corrector_t* c);
+
+// Correct the prediction 'base' of the branch at PC 'pc'. Only a
+// prediction the base made with low confidence ('weak') is overturned,
+// when the sum of the counters disagrees with it by at least the
+// threshold. Only the scratch record of the lookup changes.
+//
+// Returns the corrected prediction
+//
+uint8_t corrector_lookup(corrector_t* c, uint32_t pc, uint8_t base,
+                         int weak);
+
+// Train with the outcome of the branch of the last lookup and shift it
+// into the history
+//
+void corrector_update(corrector_t* c, uint8_t outcome);
+
+// Visit the tables and registers of the corrector
+//
+void corrector_state(corrector_t* c, bp_state_t* s);
+
+void corrector_destroy(corrector_t* c);
+
+#endif
@@ -0,0 +1,142 @@
+//========================================================//
+//  counters.h                                            //
+//  Bit-packed tables of small entries                    //
+//                                                        //
+//  Saturating counters and history registers stored at   //
+//  their exact width, back to back in memory             //
+//========================================================//
+
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Widest entry a packed table can hold. An entry starting at any bit of
+// a byte must fit in one unaligned 64-bit load.
+#define PACKED_MAX_BITS 56
+
+// A table of 'entries' entries of 'bits' bits each. Entry i occupies bits
+// [i * bits, (i + 1) * bits) of the byte array, e.g. 32 2-bit counters
+// per 64-bit word, or 21 3-bit chooser counters per 63 bits.
+typedef struct
+{
+    uint8_t* data;
+    uint32_t entries;
+    uint32_t bits;
+    uint64_t mask; // (1 << bits) - 1, also the saturation limit
+} packed_t;
+
+// Get the number of bytes holding the entries, without the padding
+//
+static inline size_t packed_bytes(const packed_t* t)
+{
+    return ((uint64_t)t->entries * t->bits + 7) / 8;
+}
+
+// Allocate a table with all entries set to 0
+//
+// Returns True if Successful
+//
+static inline int packed_init(packed_t* t, uint32_t entries, uint32_t bits)
+{
+    if (bits > PACKED_MAX_BITS)
+    {
+        return 0;
+    }
+    t->entries = entries;
+    t->bits = bits;
+    t->mask = (1ULL << bits) - 1;
+    // 8 bytes of padding so the last entry can be loaded as a word
+    t->data = (uint8_t*)calloc(packed_bytes(t) + 8, 1);
+    return t->data != NULL;
+}
+
+static inline void packed_free(packed_t* t)
+{
+    free(t->data);
+    t->data = NULL;
+}
+
+static inline uint64_t packed_load(const uint8_t* p)
+{
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+static inline void packed_store(uint8_t* p, uint64_t w)
+{
+    memcpy(p, &w, sizeof(w));
+}
+
+// Get entry 'i'
+//
+static inline uint32_t packed_get(const packed_t* t, uint32_t i)
+{
+    uint64_t bit = (uint64_t)i * t->bits;
+    return (packed_load(t->data + (bit >> 3)) >> (bit & 7)) & t->mask;
+}
+
+// Set entry 'i' to 'val'
+//
+static inline void packed_set(packed_t* t, uint32_t i, uint64_t val)
+{
+    uint64_t bit = (uint64_t)i * t->bits;
+    uint8_t* p = t->data + (bit >> 3);
+    uint64_t w = packed_load(p);
+    w &= ~(t->mask << (bit & 7));
+    w |= (val & t->mask) << (bit & 7);
+    packed_store(p, w);
+}
+
+// Set every entry to 'val'
+//
+static inline void packed_fill(packed_t* t, uint64_t val)
+{
+    if (val == 0)
+    {
+        memset(t->data, 0, packed_bytes(t) + 8);
+        return;
+    }
+    for (uint32_t i = 0; i < t->entries; i++)
+    {
+        packed_set(t, i, val);
+    }
+}
+
+// Get the most significant bit of counter 'i', its prediction
+//
+static inline uint8_t packed_msb(const packed_t* t, uint32_t i)
+{
+    return (packed_get(t, i) >> (t->bits - 1)) & 0x1;
+}
+
+// Count saturating counter 'i' up if 'up' is set, down otherwise,
+// without branching on the counter value
+//
+static inline void packed_count(packed_t* t, uint32_t i, uint8_t up)
+{
+    uint64_t bit = (uint64_t)i * t->bits;
+    uint8_t* p = t->data + (bit >> 3);
+    uint64_t w = packed_load(p);
+    uint64_t val = (w >> (bit & 7)) & t->mask;
+
+    uint64_t inc = (uint64_t)(up != 0) & (val != t->mask);
+    uint64_t dec = (uint64_t)(up == 0) & (val != 0);
+    val = val + inc - dec;
+
+    w &= ~(t->mask << (bit & 7));
+    w |= val << (bit & 7);
+    packed_store(p, w);
+}
+
+// Shift 'bit' into history register 'i'
+//
+static inline void packed_shift(packed_t* t, uint32_t i, uint8_t bit)
+{
+    packed_set(t, i, ((uint64_t)packed_get(t, i) << 1) | (bit & 0x1));
+}
+
+#endif
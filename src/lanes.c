@@ -0,0 +1,195 @@
+//========================================================//
+//  lanes.c                                               //
+//  Source file for the lockstep gshare engine            //
+//                                                        //
+//  The tables of every lane live in one byte array, so   //
+//  an AVX2 gather reads the counter of each lane at once //
+//========================================================//
+
+#define _GNU_SOURCE
+#include "lanes.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LANES_X86 1
+#endif
+
+// Counters are kept one per byte, 2-bit saturating as in gshare
+#define CTR_MAX 3
+
+// Unused lanes index a table of one entry after all the others. The
+// gather reads 4 bytes from each offset, so 4 more bytes are padding.
+typedef struct
+{
+    uint8_t* ctr;
+    uint32_t mask[LANES_WIDTH];
+    uint32_t base[LANES_WIDTH]; // offset of the table of each lane
+} lanes_t;
+
+typedef struct
+{
+    const char* name;
+    void (*run)(lanes_t* l, const trace_mem_t* mem, uint64_t* misses);
+} kernel_t;
+
+//------------------------------------//
+//              Kernels               //
+//------------------------------------//
+
+static void run_scalar(lanes_t* l, const trace_mem_t* mem, uint64_t* misses)
+{
+    uint64_t ghistory = 0;
+
+    for (uint64_t b = 0; b < mem->num_blocks; b++)
+    {
+        const trace_block_t* blk = &mem->blocks[b];
+        int count = trace_mem_count(mem, b);
+
+        for (int i = 0; i < count; i++)
+        {
+            uint32_t hash = blk->pc[i] ^ (uint32_t)ghistory;
+            uint8_t outcome = (blk->taken >> i) & 0x1;
+
+            for (int k = 0; k < LANES_WIDTH; k++)
+            {
+                uint8_t* ctr = &l->ctr[l->base[k] + (hash & l->mask[k])];
+                misses[k] += (*ctr >> 1) != outcome;
+                if (outcome == TAKEN && *ctr < CTR_MAX)
+                    (*ctr)++;
+                else if (outcome == NOTTAKEN && *ctr > 0)
+                    (*ctr)--;
+            }
+            ghistory = (ghistory << 1) | outcome;
+        }
+    }
+}
+
+static const kernel_t kernel_scalar = {"scalar", run_scalar};
+
+#ifdef LANES_X86
+
+__attribute__((target("avx2"))) static void
+run_avx2(lanes_t* l, const trace_mem_t* mem, uint64_t* misses)
+{
+    const __m256i mask = _mm256_loadu_si256((const __m256i*)l->mask);
+    const __m256i base = _mm256_loadu_si256((const __m256i*)l->base);
+    const __m256i low = _mm256_set1_epi32(0xff);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i max = _mm256_set1_epi32(CTR_MAX);
+    const __m256i zero = _mm256_setzero_si256();
+    uint64_t ghistory = 0;
+
+    for (uint64_t b = 0; b < mem->num_blocks; b++)
+    {
+        const trace_block_t* blk = &mem->blocks[b];
+        int count = trace_mem_count(mem, b);
+        // at most a block of misses per lane, counted down from 0
+        __m256i wrong = zero;
+
+        for (int i = 0; i < count; i++)
+        {
+            uint32_t hash = blk->pc[i] ^ (uint32_t)ghistory;
+            uint8_t outcome = (blk->taken >> i) & 0x1;
+
+            __m256i idx = _mm256_add_epi32(
+                _mm256_and_si256(_mm256_set1_epi32(hash), mask), base);
+            __m256i ctr = _mm256_and_si256(
+                _mm256_i32gather_epi32((const int*)l->ctr, idx, 1), low);
+
+            // taken is predicted from 2 upwards, a miss adds -1
+            __m256i taken = _mm256_cmpgt_epi32(ctr, one);
+            __m256i actual = _mm256_set1_epi32(-(int)outcome);
+            wrong = _mm256_add_epi32(wrong, _mm256_xor_si256(taken, actual));
+
+            ctr = outcome ? _mm256_min_epi32(_mm256_add_epi32(ctr, one), max)
+                          : _mm256_max_epi32(_mm256_sub_epi32(ctr, one), zero);
+
+            // AVX2 has no scatter, the lanes never share a table entry
+            uint32_t at[LANES_WIDTH], val[LANES_WIDTH];
+            _mm256_storeu_si256((__m256i*)at, idx);
+            _mm256_storeu_si256((__m256i*)val, ctr);
+            for (int k = 0; k < LANES_WIDTH; k++)
+            {
+                l->ctr[at[k]] = (uint8_t)val[k];
+            }
+            ghistory = (ghistory << 1) | outcome;
+        }
+
+        int32_t sum[LANES_WIDTH];
+        _mm256_storeu_si256((__m256i*)sum, wrong);
+        for (int k = 0; k < LANES_WIDTH; k++)
+        {
+            misses[k] -= sum[k];
+        }
+    }
+}
+
+static const kernel_t kernel_avx2 = {"avx2", run_avx2};
+
+#endif
+
+// Get the widest kernel the CPU supports
+//
+static const kernel_t* select_kernel()
+{
+#ifdef LANES_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return &kernel_avx2;
+    }
+#endif
+    return &kernel_scalar;
+}
+
+//------------------------------------//
+//          Lockstep Engine           //
+//------------------------------------//
+
+int lanes_supported(const bp_config_t* cfg)
+{
+    return cfg->bpType == GSHARE && cfg->ghistoryBits >= 0 &&
+           cfg->ghistoryBits <= LANES_MAX_BITS && cfg->loopBits == 0 &&
+           cfg->scBits == 0;
+}
+
+const char* lanes_kernel()
+{
+    return select_kernel()->name;
+}
+
+void lanes_run(const bp_config_t* cfgs, int num, const trace_mem_t* mem,
+               uint64_t* mispredictions)
+{
+    lanes_t l;
+    uint32_t size = 0;
+    for (int k = 0; k < LANES_WIDTH; k++)
+    {
+        l.mask[k] = k < num ? (1u << cfgs[k].ghistoryBits) - 1 : 0;
+        l.base[k] = size;
+        if (k < num)
+        {
+            size += l.mask[k] + 1;
+        }
+    }
+    // the spare entry of the unused lanes
+    for (int k = num; k < LANES_WIDTH; k++)
+    {
+        l.base[k] = size;
+    }
+
+    // every counter starts weakly not taken
+    l.ctr = (uint8_t*)malloc(size + 1 + 4);
+    memset(l.ctr, WN, size + 1 + 4);
+
+    uint64_t misses[LANES_WIDTH] = {0};
+    select_kernel()->run(&l, mem, misses);
+    for (int k = 0; k < num; k++)
+    {
+        mispredictions[k] = misses[k];
+    }
+
+    free(l.ctr);
+}
@@ -0,0 +1,40 @@
+//========================================================//
+//  lanes.h                                               //
+//  Header file for the lockstep gshare engine            //
+//                                                        //
+//  Simulates several gshare geometries in one pass over  //
+//  a trace, one geometry per SIMD lane                   //
+//========================================================//
+
+#ifndef LANES_H
+#define LANES_H
+
+#include "predictor.h"
+#include "trace.h"
+#include <stdint.h>
+
+// Geometries simulated together, one per 32-bit lane of an AVX2 vector
+#define LANES_WIDTH 8
+
+// Largest table a lane may use, so that every table of a group can be
+// addressed with 32-bit offsets
+#define LANES_MAX_BITS 24
+
+// Returns True if the geometry in 'cfg' can be simulated in a lane
+//
+int lanes_supported(const bp_config_t* cfg);
+
+// Get the name of the kernel ("avx2" or "scalar") used by lanes_run
+//
+const char* lanes_kernel();
+
+// Predict and train the 'num' geometries in 'cfgs', at most LANES_WIDTH
+// and each supported, together over every branch of 'mem'. Gives the
+// same predictions as simulating each of them with sim_run().
+//
+// Writes the number of mispredictions of cfgs[i] to mispredictions[i]
+//
+void lanes_run(const bp_config_t* cfgs, int num, const trace_mem_t* mem,
+               uint64_t* mispredictions);
+
+#endif
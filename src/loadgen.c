@@ -0,0 +1,285 @@
+//========================================================//
+//  loadgen.c                                             //
+//  Load generator for the predictor server               //
+//                                                        //
+//  Replays a trace against predictor --serve in batches  //
+//  and times every round trip                            //
+//========================================================//
+
+#define _GNU_SOURCE
+#include "serve.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+
+// Batch sizes timed by default
+#define NUM_DEFAULT_BATCHES 5
+const uint32_t defaultBatch[NUM_DEFAULT_BATCHES] = {1, 16, 256, 4096,
+                                                    SERVE_MAX_BATCH};
+
+// Most batch sizes in one run
+#define MAX_BATCHES 16
+
+// Print out the Usage information to stderr
+//
+void usage()
+{
+    fprintf(stderr, "Usage: loadgen <options> <trace>\n");
+    fprintf(stderr, " Replays the trace with predict and train requests to\n"
+                    " predictor --serve <socket>, once per batch size, and\n"
+                    " prints the latency and throughput of each\n");
+    fprintf(stderr, " Options:\n");
+    fprintf(stderr, " --help            Print this message\n");
+    fprintf(stderr, " --socket <path>   Socket of the server\n"
+                    "                   (default: predictor.sock)\n");
+    fprintf(stderr, " --batch <n>       Branches per request, may be\n"
+                    "                   repeated (default: 1 16 256 4096\n"
+                    "                   65536)\n");
+    fprintf(stderr, " --branches <n>    Only replay the first n branches\n");
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compare_double(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Connect to the server at 'path' and read its hello
+//
+// Returns the socket, or -1 on failure
+//
+static int connect_server(const char* path, serve_hello_t* hello)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        perror(path);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    if (!serve_read(fd, hello, sizeof(*hello)) ||
+        memcmp(hello->magic, SERVE_MAGIC, sizeof(hello->magic)) != 0 ||
+        hello->version != SERVE_VERSION)
+    {
+        fprintf(stderr, "%s is not a version %d predictor server\n", path,
+                SERVE_VERSION);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Print the header of the results table, with an Incorrect column for
+// each of the 'num' served predictors in the order of the server
+//
+static void print_header(uint32_t num)
+{
+    printf("%8s %10s %10s %10s %10s %12s", "Batch", "Requests", "Mean us",
+           "p50 us", "p99 us", "Branches/s");
+    for (uint32_t i = 0; i < num; i++)
+    {
+        char name[24];
+        snprintf(name, sizeof(name), num > 1 ? "Incorrect %u" : "Incorrect",
+                 i + 1);
+        printf(" %12s", name);
+    }
+    printf("\n");
+}
+
+// Replay the first 'num_branches' branches of 'mem' in requests of
+// 'batch' branches on a new connection, and print a row of results,
+// preceded by the header when 'first'
+//
+// Returns True if Successful
+//
+static int run_batch(const char* path, const trace_mem_t* mem,
+                     uint64_t num_branches, uint32_t batch, int first)
+{
+    serve_hello_t hello;
+    int fd = connect_server(path, &hello);
+    if (fd < 0)
+    {
+        return 0;
+    }
+    uint32_t num = hello.num_predictors;
+    if (first)
+    {
+        print_header(num);
+    }
+
+    uint64_t num_requests = (num_branches + batch - 1) / batch;
+    double* latency = (double*)malloc(num_requests * sizeof(double));
+    uint32_t* pcs = (uint32_t*)malloc(batch * sizeof(uint32_t));
+    uint8_t* outcomes = (uint8_t*)malloc(serve_bytes(batch));
+    uint8_t* preds = (uint8_t*)malloc(serve_bytes((uint64_t)batch * num));
+    uint64_t* mispredictions = (uint64_t*)calloc(num, sizeof(uint64_t));
+
+    int ok = 1;
+    double start = now();
+    for (uint64_t r = 0; ok && r < num_requests; r++)
+    {
+        uint64_t first = r * batch;
+        uint32_t count = num_branches - first < batch
+                             ? (uint32_t)(num_branches - first)
+                             : batch;
+        memset(outcomes, 0, serve_bytes(count));
+        for (uint32_t b = 0; b < count; b++)
+        {
+            const trace_block_t* blk = &mem->blocks[(first + b) / TRACE_BLOCK];
+            int i = (first + b) % TRACE_BLOCK;
+            pcs[b] = blk->pc[i];
+            outcomes[b / 8] |= ((blk->taken >> i) & 0x1) << (b % 8);
+        }
+
+        double sent = now();
+        serve_msg_t msg = {SERVE_PREDICT_TRAIN, count};
+        serve_msg_t reply;
+        ok = serve_write(fd, &msg, sizeof(msg)) &&
+             serve_write(fd, pcs, count * sizeof(uint32_t)) &&
+             serve_write(fd, outcomes, serve_bytes(count)) &&
+             serve_read(fd, &reply, sizeof(reply)) &&
+             reply.op == SERVE_OK &&
+             serve_read(fd, preds, serve_bytes((uint64_t)count * num));
+        latency[r] = now() - sent;
+
+        for (uint32_t b = 0; ok && b < count; b++)
+        {
+            uint8_t outcome = (outcomes[b / 8] >> (b % 8)) & 0x1;
+            for (uint32_t i = 0; i < num; i++)
+            {
+                uint64_t bit = (uint64_t)b * num + i;
+                mispredictions[i] += ((preds[bit / 8] >> (bit % 8)) & 0x1) !=
+                                     outcome;
+            }
+        }
+    }
+    double elapsed = now() - start;
+    close(fd);
+
+    if (ok)
+    {
+        double sum = 0;
+        for (uint64_t r = 0; r < num_requests; r++)
+        {
+            sum += latency[r];
+        }
+        qsort(latency, num_requests, sizeof(double), compare_double);
+
+        printf("%8u %10llu %10.1f %10.1f %10.1f %12.0f", batch,
+               (unsigned long long)num_requests, 1e6 * sum / num_requests,
+               1e6 * latency[num_requests / 2],
+               1e6 * latency[num_requests * 99 / 100],
+               num_branches / elapsed);
+        for (uint32_t i = 0; i < num; i++)
+        {
+            printf(" %12llu", (unsigned long long)mispredictions[i]);
+        }
+        printf("\n");
+    }
+    else
+    {
+        fprintf(stderr, "Request failed at batch size %u\n", batch);
+    }
+
+    free(latency);
+    free(pcs);
+    free(outcomes);
+    free(preds);
+    free(mispredictions);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* path = "predictor.sock";
+    const char* trace_path = NULL;
+    uint64_t num_branches = UINT64_MAX;
+    uint32_t batch[MAX_BATCHES];
+    int num_batches = 0;
+
+    // Process cmdline Arguments
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--help"))
+        {
+            usage();
+            exit(0);
+        }
+        else if (!strcmp(argv[i], "--socket") && i + 1 < argc)
+        {
+            path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--batch") && i + 1 < argc &&
+                 num_batches < MAX_BATCHES)
+        {
+            batch[num_batches] = (uint32_t)strtoul(argv[++i], NULL, 10);
+            if (batch[num_batches] == 0 ||
+                batch[num_batches] > SERVE_MAX_BATCH)
+            {
+                printf("Batch sizes go from 1 to %d\n", SERVE_MAX_BATCH);
+                exit(1);
+            }
+            num_batches++;
+        }
+        else if (!strcmp(argv[i], "--branches") && i + 1 < argc)
+        {
+            num_branches = strtoull(argv[++i], NULL, 10);
+        }
+        else if (!strncmp(argv[i], "--", 2) || trace_path != NULL)
+        {
+            printf("Unrecognized option %s\n", argv[i]);
+            usage();
+            exit(1);
+        }
+        else
+        {
+            trace_path = argv[i];
+        }
+    }
+    if (trace_path == NULL)
+    {
+        usage();
+        exit(1);
+    }
+    if (num_batches == 0)
+    {
+        memcpy(batch, defaultBatch, sizeof(defaultBatch));
+        num_batches = NUM_DEFAULT_BATCHES;
+    }
+
+    trace_mem_t mem;
+    if (!trace_load(&mem, trace_path))
+    {
+        exit(1);
+    }
+    if (num_branches > mem.num_branches)
+    {
+        num_branches = mem.num_branches;
+    }
+
+    int ok = 1;
+    for (int b = 0; ok && b < num_batches; b++)
+    {
+        ok = run_batch(path, &mem, num_branches, batch[b], b == 0);
+    }
+
+    trace_unload(&mem);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,246 @@
+//========================================================//
+//  loop.c                                                //
+//  Source file for the loop predictor                    //
+//                                                        //
+//  A loop entry counts the iterations of a branch in its //
+//  usual direction and predicts the other at the count   //
+//========================================================//
+
+#include "loop.h"
+#include "counters.h"
+#include <string.h>
+
+// Age given to new entries, and confidence of a predicting entry
+#define LOOP_NEW_AGE (1u << (LOOP_AGE_BITS - 1))
+#define LOOP_CONF    ((1u << LOOP_CONF_BITS) - 1)
+
+// Loops of fewer iterations are left to the base predictor
+#define LOOP_MIN_TRIP 3
+
+struct loop
+{
+    int bits;
+    uint32_t set_bits;
+
+    packed_t tag;
+    packed_t past;    // iterations of the last complete run, 0 unknown
+    packed_t current; // iterations of the current run
+    packed_t conf;    // runs in a row of 'past' iterations
+    packed_t age;
+    packed_t dir;     // direction of the iterations
+
+    uint32_t use;  // trust the entries when the MSB is set
+    uint32_t seed; // allocation randomness
+
+    // Scratch record of the last lookup
+    uint32_t set; // first entry of the set
+    uint32_t tag_val;
+    int hit; // entry, -1 on a miss
+    int valid;
+    uint8_t pred;
+};
+
+loop_t* loop_create(int bits)
+{
+    if (bits < LOOP_MIN_BITS || bits > LOOP_MAX_BITS)
+    {
+        return NULL;
+    }
+
+    loop_t* l = (loop_t*)calloc(1, sizeof(loop_t));
+    uint32_t entries = 1u << bits;
+    l->bits = bits;
+    l->set_bits = bits - 2;
+    packed_init(&l->tag, entries, LOOP_TAG_BITS);
+    packed_init(&l->past, entries, LOOP_ITER_BITS);
+    packed_init(&l->current, entries, LOOP_ITER_BITS);
+    packed_init(&l->conf, entries, LOOP_CONF_BITS);
+    packed_init(&l->age, entries, LOOP_AGE_BITS);
+    packed_init(&l->dir, entries, 1);
+    loop_reset(l);
+    return l;
+}
+
+void loop_reset(loop_t* l)
+{
+    packed_fill(&l->tag, 0);
+    packed_fill(&l->past, 0);
+    packed_fill(&l->current, 0);
+    packed_fill(&l->conf, 0);
+    packed_fill(&l->age, 0);
+    packed_fill(&l->dir, 0);
+    // one right override away from being trusted
+    l->use = (1u << (LOOP_USE_BITS - 1)) - 1;
+    l->seed = 0x9e3779b9;
+    l->hit = -1;
+    l->valid = 0;
+}
+
+int loop_lookup(loop_t* l, uint32_t pc, uint8_t* prediction)
+{
+    uint32_t sets = 1u << l->set_bits;
+    l->set = ((pc ^ (pc >> l->set_bits)) & (sets - 1)) * LOOP_WAYS;
+    l->tag_val = (pc >> l->set_bits) & ((1u << LOOP_TAG_BITS) - 1);
+    l->hit = -1;
+    l->valid = 0;
+
+    for (uint32_t w = 0; w < LOOP_WAYS; w++)
+    {
+        uint32_t e = l->set + w;
+        if (packed_get(&l->tag, e) == l->tag_val)
+        {
+            // the iteration before the trip count leaves the loop
+            uint8_t dir = packed_get(&l->dir, e);
+            l->hit = e;
+            l->pred = packed_get(&l->current, e) + 1 == packed_get(&l->past, e)
+                          ? !dir
+                          : dir;
+            l->valid = packed_get(&l->conf, e) == LOOP_CONF;
+            break;
+        }
+    }
+
+    *prediction = l->pred;
+    return l->valid && (l->use >> (LOOP_USE_BITS - 1));
+}
+
+// Forget the loop of entry 'e', leaving it replaceable
+//
+static void loop_free(loop_t* l, uint32_t e)
+{
+    packed_set(&l->past, e, 0);
+    packed_set(&l->current, e, 0);
+    packed_set(&l->conf, e, 0);
+    packed_set(&l->age, e, 0);
+}
+
+// Allocate an entry of the set of the last lookup for a branch that
+// left its usual direction 'outcome'
+//
+static void loop_allocate(loop_t* l, uint8_t outcome)
+{
+    // one time in four, from a random way on
+    l->seed ^= l->seed << 13;
+    l->seed ^= l->seed >> 17;
+    l->seed ^= l->seed << 5;
+    if ((l->seed & 0x3) != 0)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < LOOP_WAYS; i++)
+    {
+        uint32_t e = l->set + (((l->seed >> 2) + i) & (LOOP_WAYS - 1));
+        uint32_t age = packed_get(&l->age, e);
+        if (age > 0)
+        {
+            packed_set(&l->age, e, age - 1);
+            continue;
+        }
+        // most mispredictions are the exits of loops
+        packed_set(&l->tag, e, l->tag_val);
+        packed_set(&l->dir, e, !outcome);
+        packed_set(&l->past, e, 0);
+        packed_set(&l->current, e, 0);
+        packed_set(&l->conf, e, 0);
+        packed_set(&l->age, e, LOOP_NEW_AGE);
+        return;
+    }
+}
+
+void loop_update(loop_t* l, uint8_t input, uint8_t outcome)
+{
+    if (l->hit < 0)
+    {
+        if (input != outcome)
+        {
+            loop_allocate(l, outcome);
+        }
+        return;
+    }
+
+    uint32_t e = l->hit;
+    if (l->valid)
+    {
+        // learn whether the loop predictions beat the ones they replace
+        if (l->pred != input)
+        {
+            uint32_t max = (1u << LOOP_USE_BITS) - 1;
+            if (l->pred == outcome)
+                l->use += l->use < max;
+            else
+                l->use -= l->use > 0;
+        }
+        if (l->pred != outcome)
+        {
+            loop_free(l, e);
+            return;
+        }
+        if (l->pred != input)
+        {
+            packed_count(&l->age, e, 1);
+        }
+    }
+
+    uint32_t past = packed_get(&l->past, e);
+    uint32_t current = (packed_get(&l->current, e) + 1) &
+                       ((1u << LOOP_ITER_BITS) - 1);
+    if (current > past)
+    {
+        // longer than the last run, the trip count is not known
+        packed_set(&l->conf, e, 0);
+        packed_set(&l->past, e, 0);
+        past = 0;
+    }
+
+    if (outcome != packed_get(&l->dir, e))
+    {
+        // the loop exits
+        if (current == past)
+        {
+            packed_count(&l->conf, e, 1);
+            if (past < LOOP_MIN_TRIP)
+            {
+                packed_set(&l->dir, e, outcome);
+                loop_free(l, e);
+            }
+        }
+        else if (past == 0)
+        {
+            // the first complete run
+            packed_set(&l->conf, e, 0);
+            packed_set(&l->past, e, current);
+        }
+        else
+        {
+            // a different trip count
+            packed_set(&l->past, e, 0);
+            packed_set(&l->conf, e, 0);
+        }
+        current = 0;
+    }
+    packed_set(&l->current, e, current);
+}
+
+void loop_state(loop_t* l, bp_state_t* s)
+{
+    state_packed(s, &l->tag);
+    state_packed(s, &l->past);
+    state_packed(s, &l->current);
+    state_packed(s, &l->conf);
+    state_packed(s, &l->age);
+    state_packed(s, &l->dir);
+    state_bytes(s, &l->use, sizeof(l->use));
+    state_bytes(s, &l->seed, sizeof(l->seed));
+}
+
+void loop_destroy(loop_t* l)
+{
+    packed_free(&l->tag);
+    packed_free(&l->past);
+    packed_free(&l->current);
+    packed_free(&l->conf);
+    packed_free(&l->age);
+    packed_free(&l->dir);
+    free(l);
+}
@@ -0,0 +1,65 @@
+//========================================================//
+//  loop.h                                                //
+//  Header file for the loop predictor                    //
+//                                                        //
+//  Side predictor learning the trip counts of loops to   //
+//  predict their exits, over any base predictor          //
+//========================================================//
+
+#ifndef LOOP_H
+#define LOOP_H
+
+#include "predictor.h"
+#include "state.h"
+
+// Limits of the log2 number of entries, which come in sets of LOOP_WAYS
+#define LOOP_WAYS         4
+#define LOOP_MIN_BITS     2
+#define LOOP_MAX_BITS     16
+#define LOOP_DEFAULT_BITS 6
+
+// Entry fields
+#define LOOP_TAG_BITS  14
+#define LOOP_ITER_BITS 14 // trip count and current iteration
+#define LOOP_CONF_BITS 4  // the entry predicts once this saturates
+#define LOOP_AGE_BITS  4  // replaceable when 0
+#define LOOP_ENTRY_BITS                                                    \
+    (LOOP_TAG_BITS + 2 * LOOP_ITER_BITS + LOOP_CONF_BITS + LOOP_AGE_BITS + 1)
+
+// Width of the counter deciding whether confident entries are trusted
+// over the predictions they replace
+#define LOOP_USE_BITS 7
+
+typedef struct loop loop_t;
+
+// Create a loop predictor of 2^bits entries
+//
+// Returns NULL if 'bits' is out of range
+//
+loop_t* loop_create(int bits);
+
+// Return the loop predictor to its initial state
+//
+void loop_reset(loop_t* l);
+
+// Look up the branch at PC 'pc'. Only the scratch record of the lookup
+// changes, so a lookup may be repeated before the update.
+//
+// Returns True if a confident entry hit and loop predictions have been
+// beating the ones they replace, with its prediction in 'prediction'
+//
+int loop_lookup(loop_t* l, uint32_t pc, uint8_t* prediction);
+
+// Train with the outcome of the branch of the last lookup, where 'input'
+// is the prediction the loop predictor would replace. An entry is
+// allocated for a branch that missed when 'input' was wrong.
+//
+void loop_update(loop_t* l, uint8_t input, uint8_t outcome);
+
+// Visit the entries and registers of the loop predictor
+//
+void loop_state(loop_t* l, bp_state_t* s);
+
+void loop_destroy(loop_t* l);
+
+#endif
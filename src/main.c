@@ -5,14 +5,92 @@
 //========================================================//
 
 #define _GNU_SOURCE
+#include "alias.h"
+#include "batch.h"
+#include "corrector.h"
+#include "loop.h"
+#include "pool.h"
 #include "predictor.h"
+#include "predstream.h"
+#include "profile.h"
+#include "serve.h"
+#include "shard.h"
+#include "state.h"
+#include "sweep.h"
+#include "trace.h"
+#include "writer.h"
+#include <glob.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-FILE* stream;
-char* buf = NULL;
-size_t len = 0;
+trace_t* trace;
+
+// Predictors simulated side by side over the trace
+#define MAX_PREDICTORS 16
+int num_predictors = 0;
+bp_config_t bpConfigs[MAX_PREDICTORS];
+
+// Geometries evaluated by --sweep
+bp_config_t* sweepConfigs = NULL;
+int num_sweep = 0;
+int num_threads = 0;
+
+// Print the storage of each predictor instead of simulating
+int budget = 0;
+
+// Checkpoints of the predictor state
+const char* saveState = NULL;
+const char* loadState = NULL;
+
+// Sampled simulation: skip the first skipBranches branches, then every
+// samplePeriod branches train on warmupBranches branches and measure the
+// next measureBranches
+uint64_t skipBranches = 0;
+uint64_t warmupBranches = 0;
+uint64_t measureBranches = 0;
+uint64_t samplePeriod = 0;
+
+// Misprediction rate of each sample, as a running mean and sum of squared
+// deviations, for the confidence interval of the sampled rate
+uint64_t num_samples = 0;
+double sampleMean[MAX_PREDICTORS];
+double sampleM2[MAX_PREDICTORS];
+
+// Windowed statistics
+uint64_t intervalLength = 0;
+const char* intervalOut = NULL;
+
+// Socket of the predictor server
+const char* servePath = NULL;
+
+// Sharded simulation of one trace, each shard warmed on the shardOverlap
+// branches before it
+int numShards = 0;
+uint64_t shardOverlap = 100000;
+int shardCheck = 0;
+
+// Bit-packed stream of every prediction
+const char* predictionsOut = NULL;
+
+// Per-branch profile of the mispredictions
+int profileTop = 0;
+const char* profileCsv = NULL;
+
+// Table aliasing analysis, printing the aliasTop most conflicted entries
+// of each table, off when negative
+int aliasTop = -1;
+
+// Side components added to every simulated predictor, left out when 0
+int loopBits = 0;
+int scBits = 0;
+
+// Traces evaluated by --batch
+int batch = 0;
+double instsPerBranch = 1.0;
+char** tracePaths = NULL;
+int num_traces = 0;
 
 // Print out the Usage information to stderr
 //
@@ -20,14 +98,89 @@ void usage()
 {
     fprintf(stderr, "Usage: predictor <options> [<trace>]\n");
     fprintf(stderr, "       bunzip -kc trace.bz2 | predictor <options>\n");
+    fprintf(stderr, "       predictor <options> trace.bz2|trace.bin\n");
     fprintf(stderr, " Options:\n");
     fprintf(stderr, " --help       Print this message\n");
     fprintf(stderr, " --verbose    Print predictions on stdout\n");
-    fprintf(stderr, " --<type>     Branch prediction scheme:\n");
+    fprintf(stderr, " --predictions <file>\n"
+                    "              Write the predictions bit-packed to file\n"
+                    "              (- for stdout), see predcmp\n");
+    fprintf(stderr, " --all        Simulate every prediction scheme\n");
+    fprintf(stderr, " --<type>     Branch prediction scheme, may be repeated\n"
+                    "              to simulate several schemes in one pass:\n");
     fprintf(stderr, "    static\n"
                     "    gshare:<# ghistory>\n"
                     "    tournament:<# ghistory>:<# lhistory>:<# index>\n"
-                    "    custom\n");
+                    "    custom:<# ghistory>:<# lhistory>:<# index>\n"
+                    "   tournament and custom take an optional fourth\n"
+                    "   <# chooser> index, by default <# ghistory> - 1\n"
+                    "    tage:<# tables>:<# min history>:<# max history>:\n"
+                    "         <# index>:<# tag>\n"
+                    "    perceptron:<# history>:<# rows>\n");
+    fprintf(stderr, " --sweep <type:ranges>\n"
+                    "              Simulate every geometry in the ranges,\n"
+                    "              e.g. gshare:8..20, and print a CSV of\n"
+                    "              misprediction rate and storage bits\n");
+    fprintf(stderr, " --batch      Simulate every trace given (or matching a\n"
+                    "              quoted glob) in parallel and print a\n"
+                    "              per-trace and aggregate table\n");
+    fprintf(stderr, " --budget     Print the storage of each scheme against\n"
+                    "              the 32Kb + 320 bit budget and exit\n");
+    fprintf(stderr, " --serve <socket>\n"
+                    "              Serve batched predict and train requests\n"
+                    "              on a UNIX domain socket, see loadgen\n");
+    fprintf(stderr, " --shards <n> Split the trace into n shards simulated in\n"
+                    "              parallel\n");
+    fprintf(stderr, " --shard-overlap <n>\n"
+                    "              Train each shard on the n branches\n"
+                    "              before it (default: 100000)\n");
+    fprintf(stderr, " --shard-check\n"
+                    "              Also simulate the trace in sequence and\n"
+                    "              report the deviation of the shards\n");
+    fprintf(stderr, " --skip <n>   Fast-forward over the first n branches\n");
+    fprintf(stderr, " --warmup <n> Only train on the first n branches of\n"
+                    "              each sample\n");
+    fprintf(stderr, " --measure <n>\n"
+                    "              Predict and count the next n branches\n"
+                    "              (default: to the end of the trace),\n"
+                    "              error bounds need --period\n");
+    fprintf(stderr, " --period <n> Start a sample every n branches and\n"
+                    "              fast-forward between samples, printing\n"
+                    "              a 95%% confidence interval of the rate\n");
+    fprintf(stderr, " --interval <n>\n"
+                    "              Write the branches, mispredictions and\n"
+                    "              MPKI of every window of n branches as\n"
+                    "              CSV\n");
+    fprintf(stderr, " --interval-out <file>\n"
+                    "              Where --interval writes (default:\n"
+                    "              stdout, which --verbose also uses)\n");
+    fprintf(stderr, " --load-state <file>\n"
+                    "              Start from the predictor state saved in\n"
+                    "              file instead of cold tables\n");
+    fprintf(stderr, " --save-state <file>\n"
+                    "              Save the predictor state at the end of\n"
+                    "              the trace\n");
+    fprintf(stderr, " --profile <n>\n"
+                    "              Print the n branches with the most\n"
+                    "              mispredictions for each scheme\n");
+    fprintf(stderr, " --profile-csv <file>\n"
+                    "              Write the per-branch counts as CSV\n");
+    fprintf(stderr, " --alias <n>  Print the occupancy, sharing and\n"
+                    "              interference of every predictor table,\n"
+                    "              and its n most conflicted entries\n");
+    fprintf(stderr, " --loop[:<n>] Wrap every scheme in a loop predictor of\n"
+                    "              2^n entries (default n: %d)\n",
+            LOOP_DEFAULT_BITS);
+    fprintf(stderr, " --sc[:<n>]   Wrap every scheme in a statistical\n"
+                    "              corrector with tables of 2^n counters\n"
+                    "              (default n: %d)\n",
+            SC_DEFAULT_BITS);
+    fprintf(stderr, " --insts-per-branch <n>\n"
+                    "              Instructions per branch used for MPKI,\n"
+                    "              traces only hold branches (default: 1)\n");
+    fprintf(stderr, " --threads <n>\n"
+                    "              Threads used by --sweep and --batch\n"
+                    "              (default: cores)\n");
 }
 
 // Process an option and update the predictor
@@ -37,25 +190,41 @@ void usage()
 //
 int handle_option(char* arg)
 {
-    if (!strcmp(arg, "--static"))
+    bp_config_t cfg;
+
+    if (!strcmp(arg, "--all"))
     {
-        bpType = STATIC;
+        for (int i = STATIC; i < NUM_TYPES; i++)
+        {
+            if (num_predictors < MAX_PREDICTORS)
+            {
+                predictor_default_config(&bpConfigs[num_predictors++], i);
+            }
+        }
     }
-    else if (!strncmp(arg, "--gshare", 8))
+    else if (!strcmp(arg, "--verbose"))
     {
-        bpType = GSHARE;
+        verbose = 1;
     }
-    else if (!strncmp(arg, "--tournament", 12))
+    else if (!strcmp(arg, "--batch"))
     {
-        bpType = TOURNAMENT;
+        batch = 1;
     }
-    else if (!strncmp(arg, "--custom", 8))
+    else if (!strcmp(arg, "--budget"))
     {
-        bpType = CUSTOM;
+        budget = 1;
     }
-    else if (!strcmp(arg, "--verbose"))
+    else if (predictor_parse_config(arg + 2, &cfg))
     {
-        verbose = 1;
+        // Every scheme option adds a predictor
+        if (num_predictors == MAX_PREDICTORS)
+        {
+            printf("At most %d predictors can be simulated\n",
+                   MAX_PREDICTORS);
+            return 0;
+        }
+        bpType = cfg.bpType;
+        bpConfigs[num_predictors++] = cfg;
     }
     else
     {
@@ -65,29 +234,302 @@ int handle_option(char* arg)
     return 1;
 }
 
-// Reads a line from the input stream and extracts the
+// Add the trace at 'path' to the traces to simulate, expanding it if it
+// is a glob pattern the shell did not expand
+//
+void add_traces(const char* path)
+{
+    glob_t g;
+    if (strpbrk(path, "*?[") && glob(path, 0, NULL, &g) == 0)
+    {
+        tracePaths = (char**)realloc(
+            tracePaths, (num_traces + g.gl_pathc) * sizeof(char*));
+        for (size_t i = 0; i < g.gl_pathc; i++)
+        {
+            tracePaths[num_traces++] = strdup(g.gl_pathv[i]);
+        }
+        globfree(&g);
+        return;
+    }
+
+    tracePaths =
+        (char**)realloc(tracePaths, (num_traces + 1) * sizeof(char*));
+    tracePaths[num_traces++] = strdup(path);
+}
+
+// Print the tables and registers of 'cfg' and their total against the
+// hardware budget
+//
+// Returns True if the predictor fits the budget
+//
+int print_budget(const bp_config_t* cfg)
+{
+    char name[64];
+    bp_budget_t b;
+    predictor_config_name(cfg, name, sizeof(name));
+    predictor_budget(cfg, &b);
+
+    printf("%s\n", name);
+    printf("  %-12s %10s %6s %12s\n", "Component", "Entries", "Bits",
+           "Total bits");
+    for (int i = 0; i < b.count; i++)
+    {
+        const bp_component_t* c = &b.comp[i];
+        printf("  %-12s %10llu %6u %12llu\n", c->name,
+               (unsigned long long)c->entries, c->bits,
+               (unsigned long long)(c->entries * c->bits));
+    }
+
+    int fits = predictor_fits_budget(&b);
+    printf("  Tables:    %8llu / %u bits\n",
+           (unsigned long long)b.table_bits, BP_BUDGET_TABLE_BITS);
+    printf("  Registers: %8llu / %u bits\n", (unsigned long long)b.reg_bits,
+           BP_BUDGET_REG_BITS);
+    printf("  Total:     %8llu / %u bits, %s\n",
+           (unsigned long long)(b.table_bits + b.reg_bits),
+           BP_BUDGET_TABLE_BITS + BP_BUDGET_REG_BITS,
+           fits ? "fits" : "OVER BUDGET");
+    return fits;
+}
+
+// Get the mispredictions per thousand instructions, counting
+// instsPerBranch instructions per branch
+//
+double mpki(uint64_t mispredictions, uint64_t branches)
+{
+    return 1000.0 * mispredictions / (branches * instsPerBranch);
+}
+
+// Write the statistics of the window of 'branches' branches starting at
+// branch 'first', during which the predictors had made 'mispredictions'
+// since the start of the trace and 'start' before the window
+//
+void write_interval(writer_t* out, uint64_t window, uint64_t first,
+                    uint64_t branches, const uint64_t* mispredictions,
+                    uint64_t* start)
+{
+    for (int i = 0; i < num_predictors; i++)
+    {
+        char name[64];
+        uint64_t misses = mispredictions[i] - start[i];
+        predictor_config_name(&bpConfigs[i], name, sizeof(name));
+        writer_printf(out, "%llu,%s,%llu,%llu,%llu,%.3f,%.3f\n",
+                      (unsigned long long)window, name,
+                      (unsigned long long)first,
+                      (unsigned long long)branches,
+                      (unsigned long long)misses,
+                      100.0 * misses / branches,
+                      mpki(misses, branches));
+        start[i] = mispredictions[i];
+    }
+}
+
+// Add the sample of 'measured' branches during which the predictors went
+// from 'start' to 'mispredictions'
+//
+void add_sample(uint64_t measured, const uint64_t* mispredictions,
+                uint64_t* start)
+{
+    num_samples++;
+    for (int i = 0; i < num_predictors; i++)
+    {
+        double rate = 100.0 * (mispredictions[i] - start[i]) / measured;
+        double delta = rate - sampleMean[i];
+        sampleMean[i] += delta / num_samples;
+        sampleM2[i] += delta * (rate - sampleMean[i]);
+        start[i] = mispredictions[i];
+    }
+}
+
+// Get the half width of the 95% confidence interval of the misprediction
+// rate of predictor 'i' from the spread of its samples
+//
+// Returns a negative value with fewer than two samples
+//
+double sample_interval(int i)
+{
+    if (num_samples < 2)
+    {
+        return -1;
+    }
+    double stddev = sqrt(sampleM2[i] / (num_samples - 1));
+    return 1.96 * stddev / sqrt((double)num_samples);
+}
+
+// Print the mispredictions of every predictor over 'num_branches'
+// branches, with the confidence intervals of a sampled run
+//
+void print_stats(uint64_t num_branches, const uint64_t* mispredictions,
+                 int sampling)
+{
+    // a single sample, as without --period, has no spread to bound
+    sampling = sampling && num_samples >= 2;
+
+    if (num_predictors == 1)
+    {
+        printf("Branches:        %10llu\n", (unsigned long long)num_branches);
+        printf("Incorrect:       %10llu\n",
+               (unsigned long long)mispredictions[0]);
+        double mispredict_rate =
+            100 * ((double)mispredictions[0] / (double)num_branches);
+        printf("Misprediction Rate: %7.3f\n", mispredict_rate);
+        printf("MPKI:               %7.3f\n",
+               mpki(mispredictions[0], num_branches));
+        if (sampling)
+        {
+            printf("Samples:         %10llu\n",
+                   (unsigned long long)num_samples);
+            if (sample_interval(0) >= 0)
+                printf("95%% CI:         +/- %7.3f\n", sample_interval(0));
+        }
+    }
+    else
+    {
+        int width = predictor_name_width(bpConfigs, num_predictors);
+        printf("%-*s %10s %10s %18s %8s%s\n", width, "Predictor",
+               "Branches", "Incorrect", "Misprediction Rate", "MPKI",
+               sampling ? "     95% CI" : "");
+        for (int i = 0; i < num_predictors; i++)
+        {
+            char name[64];
+            predictor_config_name(&bpConfigs[i], name, sizeof(name));
+            double mispredict_rate =
+                100 * ((double)mispredictions[i] / (double)num_branches);
+            printf("%-*s %10llu %10llu %18.3f %8.3f", width, name,
+                   (unsigned long long)num_branches,
+                   (unsigned long long)mispredictions[i], mispredict_rate,
+                   mpki(mispredictions[i], num_branches));
+            if (sampling && sample_interval(i) >= 0)
+                printf("  +/- %6.3f", sample_interval(i));
+            printf("\n");
+        }
+        if (sampling)
+        {
+            printf("Samples: %llu\n", (unsigned long long)num_samples);
+        }
+    }
+}
+
+// Add the side components given on the command line to 'cfg'
+//
+void add_side(bp_config_t* cfg)
+{
+    if (loopBits > 0)
+    {
+        cfg->loopBits = loopBits;
+    }
+    if (scBits > 0)
+    {
+        cfg->scBits = scBits;
+    }
+}
+
+// Print the storage of the side components of every predictor in 'bp'
+// that has them, and the mispredictions each of them saved
+//
+void print_side(predictor_t** bp)
+{
+    for (int i = 0; i < num_predictors; i++)
+    {
+        const bp_config_t* cfg = predictor_config(bp[i]);
+        if (cfg->loopBits == 0 && cfg->scBits == 0)
+        {
+            continue;
+        }
+
+        char name[64];
+        bp_side_stats_t s;
+        uint64_t bits[2];
+        predictor_config_name(cfg, name, sizeof(name));
+        predictor_side_stats(bp[i], &s);
+        predictor_side_bits(cfg, &bits[1], &bits[0]);
+
+        const char* comp[2] = {"corrector", "loop"};
+        uint64_t right[2] = {s.sc_right, s.loop_right};
+        uint64_t wrong[2] = {s.sc_wrong, s.loop_wrong};
+        int64_t saved = 0;
+
+        printf("\nSide components of %s\n", name);
+        printf("  %-10s %10s %10s %10s %10s %10s\n", "Component", "Bits",
+               "Right", "Wrong", "Saved", "MPKI gain");
+        for (int c = 0; c < 2; c++)
+        {
+            if (bits[c] == 0)
+                continue;
+            int64_t diff = (int64_t)(right[c] - wrong[c]);
+            saved += diff;
+            printf("  %-10s %10llu %10llu %10llu %+10lld %+10.3f\n", comp[c],
+                   (unsigned long long)bits[c], (unsigned long long)right[c],
+                   (unsigned long long)wrong[c], (long long)diff,
+                   s.branches ? 1000.0 * diff / (s.branches * instsPerBranch)
+                              : 0.0);
+        }
+        if (s.branches > 0)
+        {
+            printf("  Base:      %10llu mispredictions, MPKI %.3f\n",
+                   (unsigned long long)s.base_mispredictions,
+                   mpki(s.base_mispredictions, s.branches));
+            printf("  With side: %10llu mispredictions, MPKI %.3f\n",
+                   (unsigned long long)(s.base_mispredictions - saved),
+                   mpki(s.base_mispredictions - saved, s.branches));
+        }
+    }
+}
+
+// Reads the next branch from the trace and extracts the
 // PC and Outcome of a branch
 //
 // Returns True if Successful
 //
 int read_branch(uint32_t* pc, uint8_t* outcome)
 {
-    if (getline(&buf, &len, stream) == -1)
+    return trace_read(trace, pc, outcome);
+}
+
+// Predict and train every predictor in 'bp' on the rest of the trace, a
+// whole block at a time through the simulation loop of each predictor,
+// adding their mispredictions to 'mispredictions'
+//
+// Returns the number of branches
+//
+uint64_t run_blocks(predictor_t** bp, uint64_t* mispredictions)
+{
+    uint64_t num_branches = 0;
+
+    // finish the block a skip may have stopped in
+    if (trace->blk != NULL && trace->blk_pos < trace->blk_count)
     {
-        return 0;
+        const trace_block_t* blk = trace->blk;
+        int first = trace->blk_pos;
+        int count = trace->blk_count - first;
+        for (int i = 0; i < num_predictors; i++)
+        {
+            mispredictions[i] += predictor_run(bp[i], blk->pc + first,
+                                               blk->taken >> first, count);
+        }
+        num_branches += count;
+        trace->blk_pos = trace->blk_count;
     }
 
-    uint32_t tmp;
-    sscanf(buf, "0x%x %d\n", pc, &tmp);
-    *outcome = tmp;
+    const trace_block_t* blk;
+    int count;
+    while ((blk = trace_next_block(trace, &count)) != NULL)
+    {
+        for (int i = 0; i < num_predictors; i++)
+        {
+            mispredictions[i] += predictor_run(bp[i], blk->pc, blk->taken,
+                                               count);
+        }
+        num_branches += count;
+    }
 
-    return 1;
+    return num_branches;
 }
 
 int main(int argc, char* argv[])
 {
     // Set defaults
-    stream = stdin;
+    const char* trace_path = NULL;
     bpType = STATIC;
     verbose = 0;
 
@@ -99,6 +541,112 @@ int main(int argc, char* argv[])
             usage();
             exit(0);
         }
+        else if (!strcmp(argv[i], "--sweep") && i + 1 < argc)
+        {
+            if (!sweep_parse(argv[++i], &sweepConfigs, &num_sweep))
+            {
+                printf("Invalid sweep %s\n", argv[i]);
+                usage();
+                exit(1);
+            }
+        }
+        else if (!strcmp(argv[i], "--serve") && i + 1 < argc)
+        {
+            servePath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--shards") && i + 1 < argc)
+        {
+            numShards = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--shard-overlap") && i + 1 < argc)
+        {
+            shardOverlap = strtoull(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--shard-check"))
+        {
+            shardCheck = 1;
+        }
+        else if (!strcmp(argv[i], "--skip") && i + 1 < argc)
+        {
+            skipBranches = strtoull(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--warmup") && i + 1 < argc)
+        {
+            warmupBranches = strtoull(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--measure") && i + 1 < argc)
+        {
+            measureBranches = strtoull(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--period") && i + 1 < argc)
+        {
+            samplePeriod = strtoull(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--interval") && i + 1 < argc)
+        {
+            intervalLength = strtoull(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--interval-out") && i + 1 < argc)
+        {
+            intervalOut = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--predictions") && i + 1 < argc)
+        {
+            predictionsOut = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--save-state") && i + 1 < argc)
+        {
+            saveState = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--load-state") && i + 1 < argc)
+        {
+            loadState = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--profile") && i + 1 < argc)
+        {
+            profileTop = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--alias") && i + 1 < argc)
+        {
+            aliasTop = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--profile-csv") && i + 1 < argc)
+        {
+            profileCsv = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+        {
+            num_threads = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--loop") || !strncmp(argv[i], "--loop:", 7))
+        {
+            loopBits = argv[i][6] ? atoi(argv[i] + 7) : LOOP_DEFAULT_BITS;
+            if (loopBits < LOOP_MIN_BITS || loopBits > LOOP_MAX_BITS)
+            {
+                printf("Loop predictors have 2^%d to 2^%d entries\n",
+                       LOOP_MIN_BITS, LOOP_MAX_BITS);
+                exit(1);
+            }
+        }
+        else if (!strcmp(argv[i], "--sc") || !strncmp(argv[i], "--sc:", 5))
+        {
+            scBits = argv[i][4] ? atoi(argv[i] + 5) : SC_DEFAULT_BITS;
+            if (scBits < SC_MIN_BITS || scBits > SC_MAX_BITS)
+            {
+                printf("Corrector tables have 2^%d to 2^%d entries\n",
+                       SC_MIN_BITS, SC_MAX_BITS);
+                exit(1);
+            }
+        }
+        else if (!strcmp(argv[i], "--insts-per-branch") && i + 1 < argc)
+        {
+            instsPerBranch = atof(argv[++i]);
+            if (instsPerBranch <= 0)
+            {
+                printf("Invalid instructions per branch %s\n", argv[i]);
+                exit(1);
+            }
+        }
         else if (!strncmp(argv[i], "--", 2))
         {
             if (!handle_option(argv[i]))
@@ -111,47 +659,404 @@ int main(int argc, char* argv[])
         else
         {
             // Use as input file
-            stream = fopen(argv[i], "r");
+            trace_path = argv[i];
+            add_traces(argv[i]);
+        }
+    }
+
+    if (num_threads <= 0)
+    {
+        num_threads = pool_default_threads();
+    }
+    if (samplePeriod > 0 &&
+        (measureBranches == 0 ||
+         samplePeriod < warmupBranches + measureBranches))
+    {
+        printf("A sampling period needs --measure and must cover the warm "
+               "up and measurement\n");
+        exit(1);
+    }
+
+    // Streams written to stdout by background writers would interleave
+    int stdout_streams = (verbose != 0) +
+                         (predictionsOut != NULL &&
+                          !strcmp(predictionsOut, "-")) +
+                         (intervalLength > 0 &&
+                          (intervalOut == NULL || !strcmp(intervalOut, "-")));
+    if (stdout_streams > 1)
+    {
+        printf("Only one of --verbose, --predictions - and --interval can "
+               "write to stdout.\nWrite the others to a file with "
+               "--predictions <file> or --interval-out <file>\n");
+        exit(1);
+    }
+    if (numShards > 0 &&
+        (verbose || predictionsOut || intervalLength || profileTop ||
+         aliasTop >= 0 ||
+         profileCsv || loadState || saveState || skipBranches ||
+         warmupBranches || measureBranches))
+    {
+        printf("--shards only counts the mispredictions of whole traces\n");
+        exit(1);
+    }
+    if ((num_sweep > 0 || numShards > 0) && !budget && num_traces > 1)
+    {
+        printf("--sweep and --shards run on a single trace, use --batch "
+               "for several\n");
+        exit(1);
+    }
+    if (num_traces == 1)
+    {
+        // a quoted glob may have matched the one trace
+        trace_path = tracePaths[0];
+    }
+
+    // Without a scheme, budgets cover every type and simulations the
+    // default one
+    if (num_predictors == 0 && num_sweep == 0)
+    {
+        for (int i = STATIC; i < NUM_TYPES; i++)
+        {
+            if (budget || i == bpType)
+                predictor_default_config(&bpConfigs[num_predictors++], i);
+        }
+    }
+
+    // Side components wrap every scheme
+    for (int i = 0; i < num_predictors; i++)
+    {
+        add_side(&bpConfigs[i]);
+    }
+    for (int i = 0; i < num_sweep; i++)
+    {
+        add_side(&sweepConfigs[i]);
+    }
+
+    // Budgets only need the geometries, no trace is read
+    if (budget)
+    {
+        int fits = 1;
+        for (int i = 0; i < num_predictors; i++)
+        {
+            fits = print_budget(&bpConfigs[i]) && fits;
+        }
+        for (int i = 0; i < num_sweep; i++)
+        {
+            fits = print_budget(&sweepConfigs[i]) && fits;
         }
+        free(sweepConfigs);
+        return fits ? 0 : 2;
     }
 
-    // Initialize the predictor
-    init_predictor();
+    // The server takes its branches from clients instead of a trace
+    if (servePath != NULL)
+    {
+        return serve_run(servePath, bpConfigs, num_predictors) ? 0 : 1;
+    }
+
+    // Sweeps share one in-memory copy of the trace across all threads
+    if (num_sweep > 0)
+    {
+        trace_mem_t mem;
+        if (!trace_load(&mem, trace_path))
+        {
+            exit(1);
+        }
+
+        // predictors given on their own join the sweep
+        sweepConfigs = (bp_config_t*)realloc(
+            sweepConfigs, (num_sweep + num_predictors) * sizeof(bp_config_t));
+        memcpy(&sweepConfigs[num_sweep], bpConfigs,
+               num_predictors * sizeof(bp_config_t));
+        num_sweep += num_predictors;
 
-    uint32_t num_branches = 0;
-    uint32_t mispredictions = 0;
+        sweep_run(sweepConfigs, num_sweep, &mem, num_threads, stdout);
+
+        free(sweepConfigs);
+        trace_unload(&mem);
+        return 0;
+    }
+
+    // Batches run each trace on its own worker
+    if (batch || num_traces > 1)
+    {
+        int ok = batch_run(tracePaths, num_traces, bpConfigs, num_predictors,
+                           num_threads, instsPerBranch, stdout);
+        for (int i = 0; i < num_traces; i++)
+        {
+            free(tracePaths[i]);
+        }
+        free(tracePaths);
+        return ok ? 0 : 1;
+    }
+
+    // Shards of one trace in memory run on every worker
+    if (numShards > 0)
+    {
+        trace_mem_t mem;
+        if (!trace_load(&mem, trace_path))
+        {
+            exit(1);
+        }
+
+        uint64_t mispredictions[MAX_PREDICTORS];
+        uint64_t exact[MAX_PREDICTORS];
+        shard_run(&mem, bpConfigs, num_predictors, numShards, shardOverlap,
+                  num_threads, mispredictions, shardCheck ? exact : NULL);
+        print_stats(mem.num_branches, mispredictions, 0);
+        if (shardCheck)
+        {
+            printf("\n");
+            shard_report(stdout, bpConfigs, num_predictors, mem.num_branches,
+                         mispredictions, exact);
+        }
+
+        trace_unload(&mem);
+        return 0;
+    }
+
+    // Open the trace, detecting compression and text or binary format
+    if ((trace = trace_open(trace_path)) == NULL)
+    {
+        exit(1);
+    }
+
+    // Initialize the predictors
+    predictor_t* bp[MAX_PREDICTORS];
+    uint64_t mispredictions[MAX_PREDICTORS];
+    for (int i = 0; i < num_predictors; i++)
+    {
+        bp[i] = predictor_create(&bpConfigs[i]);
+        mispredictions[i] = 0;
+    }
+    if (loadState != NULL && !state_load(loadState, bp, num_predictors))
+    {
+        exit(1);
+    }
+
+    profile_t* prof = NULL;
+    if (profileTop > 0 || profileCsv != NULL)
+    {
+        prof = profile_create(num_predictors);
+    }
+    alias_t* alias = NULL;
+    if (aliasTop >= 0)
+    {
+        alias = alias_create(bpConfigs, num_predictors);
+    }
+
+    writer_t* intervals = NULL;
+    uint64_t windowStart[MAX_PREDICTORS] = {0};
+    uint64_t window = 0, windowLeft = intervalLength;
+    if (intervalLength > 0)
+    {
+        if ((intervals = writer_open(intervalOut)) == NULL)
+        {
+            exit(1);
+        }
+        writer_printf(intervals, "interval,predictor,first_branch,branches,"
+                                 "mispredictions,misprediction_rate,mpki\n");
+    }
+
+    // Predictions are written through the asynchronous writer, printing
+    // a line per branch would take longer than predicting
+    writer_t* verboseOut = NULL;
+    char line[2 * MAX_PREDICTORS];
+    if (verbose != 0 && (verboseOut = writer_open(NULL)) == NULL)
+    {
+        exit(1);
+    }
+    predstream_t* predictions = NULL;
+    if (predictionsOut != NULL &&
+        (predictions = predstream_open(predictionsOut, num_predictors)) ==
+            NULL)
+    {
+        exit(1);
+    }
+
+    uint64_t num_branches = 0;
     uint32_t pc = 0;
     uint8_t outcome = NOTTAKEN;
+    uint32_t slot = 0;
+
+    int sampling = warmupBranches > 0 || measureBranches > 0;
+    uint64_t sampleStart[MAX_PREDICTORS] = {0};
+    int more = 1;
+
+    // Fast-forward without predicting or training
+    if (skipBranches > 0 && trace_skip(trace, skipBranches) < skipBranches)
+    {
+        more = 0;
+    }
 
-    // Reach each branch from the trace
-    while (read_branch(&pc, &outcome))
+    // Without any per-branch output, whole blocks are simulated without
+    // dispatching on the predictor type for every branch
+    if (more && !sampling && verboseOut == NULL && predictions == NULL &&
+        prof == NULL && alias == NULL && intervals == NULL)
     {
-        num_branches++;
+        num_branches = run_blocks(bp, mispredictions);
+        more = 0;
+    }
 
-        // Make a prediction and compare with actual outcome
-        uint8_t prediction = make_prediction(pc);
-        if (prediction != outcome)
+    while (more)
+    {
+        // Warm up, only training the predictors
+        for (uint64_t w = 0;
+             w < warmupBranches && (more = read_branch(&pc, &outcome)); w++)
         {
-            mispredictions++;
+            for (int i = 0; i < num_predictors; i++)
+            {
+                predictor_train(bp[i], pc, outcome);
+            }
         }
-        if (verbose != 0)
+
+        // Reach each branch from the trace
+        uint64_t measured = 0;
+        while (more && (measureBranches == 0 || measured < measureBranches) &&
+               (more = read_branch(&pc, &outcome)))
         {
-            printf("%d\n", prediction);
+            num_branches++;
+            measured++;
+            if (prof != NULL)
+            {
+                slot = profile_branch(prof, pc, outcome);
+            }
+
+            for (int i = 0; i < num_predictors; i++)
+            {
+                // Make a prediction and train the predictor in one step, then
+                // compare with actual outcome
+                uint8_t prediction;
+                if (alias != NULL)
+                {
+                    // the analyzer needs the entries of the lookup
+                    bp_lookup_t rec;
+                    prediction = predictor_lookup(bp[i], pc, &rec);
+                    alias_record(alias, i, pc, &rec, outcome);
+                    predictor_update(bp[i], &rec, outcome);
+                }
+                else
+                {
+                    prediction =
+                        predictor_predict_and_update(bp[i], pc, outcome);
+                }
+                if (prediction != outcome)
+                {
+                    mispredictions[i]++;
+                    if (prof != NULL)
+                    {
+                        profile_miss(prof, slot, i);
+                    }
+                }
+                if (verboseOut != NULL)
+                {
+                    line[2 * i] = '0' + prediction;
+                    line[2 * i + 1] = i + 1 < num_predictors ? ' ' : '\n';
+                }
+                if (predictions != NULL)
+                {
+                    predstream_add(predictions, prediction);
+                }
+            }
+            if (verboseOut != NULL)
+            {
+                writer_write(verboseOut, line, 2 * num_predictors);
+            }
+
+            if (intervals != NULL && --windowLeft == 0)
+            {
+                write_interval(intervals, window++,
+                               num_branches - intervalLength, intervalLength,
+                               mispredictions, windowStart);
+                windowLeft = intervalLength;
+            }
+        }
+
+        if (sampling && measured > 0)
+        {
+            add_sample(measured, mispredictions, sampleStart);
+        }
+
+        // Fast-forward to the next sample
+        if (samplePeriod == 0)
+        {
+            break;
         }
+        uint64_t gap = samplePeriod - warmupBranches - measureBranches;
+        if (more && trace_skip(trace, gap) < gap)
+        {
+            more = 0;
+        }
+    }
+
+    if (intervals != NULL)
+    {
+        // the last window may be partial
+        if (windowLeft < intervalLength)
+        {
+            uint64_t partial = intervalLength - windowLeft;
+            write_interval(intervals, window, num_branches - partial, partial,
+                           mispredictions, windowStart);
+        }
+        if (!writer_close(intervals))
+        {
+            fprintf(stderr, "Failed writing the intervals\n");
+            exit(1);
+        }
+    }
+
+    if (verboseOut != NULL && !writer_close(verboseOut))
+    {
+        fprintf(stderr, "Failed writing the predictions\n");
+        exit(1);
+    }
+    if (predictions != NULL && !predstream_close(predictions))
+    {
+        fprintf(stderr, "Failed writing %s\n", predictionsOut);
+        exit(1);
+    }
 
-        // Train the predictor
-        train_predictor(pc, outcome);
+    // Statistics of a partial trace would pass for those of the whole one
+    if (trace->error)
+    {
+        exit(1);
     }
 
     // Print out the mispredict statistics
-    printf("Branches:        %10d\n", num_branches);
-    printf("Incorrect:       %10d\n", mispredictions);
-    float mispredict_rate = 100 * ((float)mispredictions / (float)num_branches);
-    printf("Misprediction Rate: %7.3f\n", mispredict_rate);
+    print_stats(num_branches, mispredictions, sampling);
+    print_side(bp);
+
+    if (saveState != NULL && !state_save(saveState, bp, num_predictors))
+    {
+        exit(1);
+    }
+
+    if (prof != NULL)
+    {
+        if (profileTop > 0)
+        {
+            profile_report(prof, bpConfigs, profileTop, stdout);
+        }
+        if (profileCsv != NULL && !profile_write_csv(prof, bpConfigs,
+                                                     profileCsv))
+        {
+            exit(1);
+        }
+        profile_destroy(prof);
+    }
+
+    if (alias != NULL)
+    {
+        alias_report(alias, aliasTop, stdout);
+        alias_destroy(alias);
+    }
 
     // Cleanup
-    fclose(stream);
-    free(buf);
+    for (int i = 0; i < num_predictors; i++)
+    {
+        predictor_destroy(bp[i]);
+    }
+    trace_close(trace);
 
     return 0;
 }
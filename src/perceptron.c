@@ -0,0 +1,301 @@
+//========================================================//
+//  perceptron.c                                          //
+//  Source file for the perceptron predictor              //
+//                                                        //
+//  The dot product and training run over whole vectors   //
+//  of 8-bit weights, with AVX2, SSE4.1 or scalar kernels //
+//  picked at run time                                    //
+//========================================================//
+
+#define _GNU_SOURCE
+#include "perceptron.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PERCEPTRON_X86 1
+#endif
+
+// Weights are processed in vectors of this many, rows are padded to it
+#define PERCEPTRON_LANES 32
+
+// Weights saturate symmetrically so negating one never overflows
+#define WEIGHT_MAX 127
+#define WEIGHT_MIN (-127)
+
+// A dot product and training kernel over 'n' weights, n a multiple of
+// PERCEPTRON_LANES. History entries are +1 (taken) or -1 (not taken).
+typedef struct
+{
+    const char* name;
+    int32_t (*dot)(const int8_t* w, const int8_t* h, int n);
+    // add 't' (+1 or -1) times the history to the weights under 'mask'
+    void (*train)(int8_t* w, const int8_t* h, const int8_t* mask, int n,
+                  int8_t t);
+} kernel_t;
+
+struct perceptron
+{
+    bp_config_t cfg;
+    int history;
+    int stride; // weights per row, history padded to PERCEPTRON_LANES
+    int rows;
+    int theta;  // training threshold
+
+    int8_t* weights; // rows x stride
+    int8_t* bias;    // rows
+    int8_t* mask;    // -1 for the lanes holding history, 0 for padding
+
+    // Global history, doubled so that the window starting at the newest
+    // entry hist[pos] always holds the last 'history' outcomes in order
+    int8_t* hist;
+    int pos;
+
+    const kernel_t* kernel;
+};
+
+//------------------------------------//
+//              Kernels               //
+//------------------------------------//
+
+static int32_t dot_scalar(const int8_t* w, const int8_t* h, int n)
+{
+    int32_t sum = 0;
+    for (int i = 0; i < n; i++)
+    {
+        sum += w[i] * h[i];
+    }
+    return sum;
+}
+
+static void train_scalar(int8_t* w, const int8_t* h, const int8_t* mask,
+                         int n, int8_t t)
+{
+    for (int i = 0; i < n; i++)
+    {
+        int v = w[i] + (t * h[i] & mask[i]);
+        w[i] = v > WEIGHT_MAX ? WEIGHT_MAX : v < WEIGHT_MIN ? WEIGHT_MIN : v;
+    }
+}
+
+static const kernel_t kernel_scalar = {"scalar", dot_scalar, train_scalar};
+
+#ifdef PERCEPTRON_X86
+
+__attribute__((target("avx2"))) static int32_t
+dot_avx2(const int8_t* w, const int8_t* h, int n)
+{
+    const __m256i ones8 = _mm256_set1_epi8(1);
+    const __m256i ones16 = _mm256_set1_epi16(1);
+    __m256i acc = _mm256_setzero_si256();
+
+    for (int i = 0; i < n; i += 32)
+    {
+        // w * h, then widen to 16 and 32 bits adding neighbours
+        __m256i wv = _mm256_loadu_si256((const __m256i*)(w + i));
+        __m256i hv = _mm256_loadu_si256((const __m256i*)(h + i));
+        __m256i x = _mm256_sign_epi8(wv, hv);
+        __m256i s16 = _mm256_maddubs_epi16(ones8, x);
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(s16, ones16));
+    }
+
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc),
+                              _mm256_extracti128_si256(acc, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+    return _mm_cvtsi128_si32(s);
+}
+
+__attribute__((target("avx2"))) static void
+train_avx2(int8_t* w, const int8_t* h, const int8_t* mask, int n, int8_t t)
+{
+    const __m256i sign = _mm256_set1_epi8(t);
+    const __m256i lo = _mm256_set1_epi8(WEIGHT_MIN);
+
+    for (int i = 0; i < n; i += 32)
+    {
+        __m256i hv = _mm256_loadu_si256((const __m256i*)(h + i));
+        __m256i mv = _mm256_loadu_si256((const __m256i*)(mask + i));
+        __m256i d = _mm256_and_si256(_mm256_sign_epi8(hv, sign), mv);
+        __m256i v = _mm256_adds_epi8(_mm256_loadu_si256((__m256i*)(w + i)), d);
+        _mm256_storeu_si256((__m256i*)(w + i), _mm256_max_epi8(v, lo));
+    }
+}
+
+static const kernel_t kernel_avx2 = {"avx2", dot_avx2, train_avx2};
+
+__attribute__((target("ssse3,sse4.1"))) static int32_t
+dot_sse(const int8_t* w, const int8_t* h, int n)
+{
+    const __m128i ones8 = _mm_set1_epi8(1);
+    const __m128i ones16 = _mm_set1_epi16(1);
+    __m128i acc = _mm_setzero_si128();
+
+    for (int i = 0; i < n; i += 16)
+    {
+        __m128i x = _mm_sign_epi8(_mm_loadu_si128((const __m128i*)(w + i)),
+                                  _mm_loadu_si128((const __m128i*)(h + i)));
+        __m128i s16 = _mm_maddubs_epi16(ones8, x);
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(s16, ones16));
+    }
+
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4e));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xb1));
+    return _mm_cvtsi128_si32(acc);
+}
+
+__attribute__((target("ssse3,sse4.1"))) static void
+train_sse(int8_t* w, const int8_t* h, const int8_t* mask, int n, int8_t t)
+{
+    const __m128i sign = _mm_set1_epi8(t);
+    const __m128i lo = _mm_set1_epi8(WEIGHT_MIN);
+
+    for (int i = 0; i < n; i += 16)
+    {
+        __m128i d = _mm_sign_epi8(_mm_loadu_si128((const __m128i*)(h + i)),
+                                  sign);
+        d = _mm_and_si128(d, _mm_loadu_si128((const __m128i*)(mask + i)));
+        __m128i v = _mm_adds_epi8(_mm_loadu_si128((__m128i*)(w + i)), d);
+        _mm_storeu_si128((__m128i*)(w + i), _mm_max_epi8(v, lo));
+    }
+}
+
+static const kernel_t kernel_sse = {"sse4.1", dot_sse, train_sse};
+
+#endif
+
+// Get the widest kernel the CPU supports
+//
+static const kernel_t* select_kernel()
+{
+#ifdef PERCEPTRON_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return &kernel_avx2;
+    }
+    if (__builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1"))
+    {
+        return &kernel_sse;
+    }
+#endif
+    return &kernel_scalar;
+}
+
+//------------------------------------//
+//       Perceptron Predictor         //
+//------------------------------------//
+
+int perceptron_valid_config(const bp_config_t* cfg)
+{
+    return cfg->ghistoryBits >= 1 &&
+           cfg->ghistoryBits <= PERCEPTRON_MAX_HISTORY &&
+           cfg->numRows >= 1 && cfg->numRows <= PERCEPTRON_MAX_ROWS;
+}
+
+perceptron_t* perceptron_create(const bp_config_t* cfg)
+{
+    if (!perceptron_valid_config(cfg))
+    {
+        return NULL;
+    }
+
+    perceptron_t* p = (perceptron_t*)calloc(1, sizeof(perceptron_t));
+    p->cfg = *cfg;
+    p->history = cfg->ghistoryBits;
+    p->stride = (p->history + PERCEPTRON_LANES - 1) & ~(PERCEPTRON_LANES - 1);
+    p->rows = cfg->numRows;
+    // threshold from Jimenez and Lin, "Dynamic Branch Prediction with
+    // Perceptrons"
+    p->theta = (int)(1.93 * p->history + 14);
+
+    void* mem;
+    if (posix_memalign(&mem, PERCEPTRON_LANES,
+                       (size_t)p->rows * p->stride) != 0)
+    {
+        free(p);
+        return NULL;
+    }
+    p->weights = (int8_t*)mem;
+    p->bias = (int8_t*)malloc(p->rows);
+    p->mask = (int8_t*)malloc(p->stride);
+    p->hist = (int8_t*)malloc(p->history + p->stride);
+    for (int i = 0; i < p->stride; i++)
+    {
+        p->mask[i] = i < p->history ? -1 : 0;
+    }
+
+    p->kernel = select_kernel();
+    perceptron_reset(p);
+    return p;
+}
+
+const char* perceptron_kernel(const perceptron_t* p)
+{
+    return p->kernel->name;
+}
+
+void perceptron_reset(perceptron_t* p)
+{
+    memset(p->weights, 0, (size_t)p->rows * p->stride);
+    memset(p->bias, 0, p->rows);
+    // an empty history reads as not taken
+    memset(p->hist, -1, p->history + p->stride);
+    p->pos = 0;
+}
+
+uint8_t perceptron_lookup(perceptron_t* p, uint32_t pc, bp_lookup_t* rec)
+{
+    rec->index = pc % p->rows;
+    rec->output =
+        p->bias[rec->index] +
+        p->kernel->dot(p->weights + (size_t)rec->index * p->stride,
+                       p->hist + p->pos, p->stride);
+    rec->prediction = rec->output >= 0 ? TAKEN : NOTTAKEN;
+    return rec->prediction;
+}
+
+int perceptron_weak(const perceptron_t* p, const bp_lookup_t* rec)
+{
+    return abs(rec->output) <= p->theta;
+}
+
+void perceptron_update(perceptron_t* p, const bp_lookup_t* rec,
+                       uint8_t outcome)
+{
+    int8_t t = outcome == TAKEN ? 1 : -1;
+
+    if (rec->prediction != outcome || abs(rec->output) <= p->theta)
+    {
+        int8_t* bias = &p->bias[rec->index];
+        if ((t > 0 && *bias < WEIGHT_MAX) || (t < 0 && *bias > WEIGHT_MIN))
+        {
+            *bias += t;
+        }
+        p->kernel->train(p->weights + (size_t)rec->index * p->stride,
+                         p->hist + p->pos, p->mask, p->stride, t);
+    }
+
+    // the newest outcome goes in front of the window, and into the copy
+    // one history length further on
+    p->pos = p->pos == 0 ? p->history - 1 : p->pos - 1;
+    p->hist[p->pos] = t;
+    p->hist[p->pos + p->history] = t;
+}
+
+void perceptron_state(perceptron_t* p, bp_state_t* s)
+{
+    state_bytes(s, p->weights, (size_t)p->rows * p->stride);
+    state_bytes(s, p->bias, p->rows);
+    state_bytes(s, p->hist, p->history + p->stride);
+    state_bytes(s, &p->pos, sizeof(p->pos));
+}
+
+void perceptron_destroy(perceptron_t* p)
+{
+    free(p->weights);
+    free(p->bias);
+    free(p->mask);
+    free(p->hist);
+    free(p);
+}
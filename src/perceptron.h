@@ -0,0 +1,64 @@
+//========================================================//
+//  perceptron.h                                          //
+//  Header file for the perceptron predictor              //
+//                                                        //
+//  One row of signed weights per branch address, dotted  //
+//  with the global history using SIMD where available    //
+//========================================================//
+
+#ifndef PERCEPTRON_H
+#define PERCEPTRON_H
+
+#include "predictor.h"
+#include "state.h"
+
+// Limits of the geometry
+#define PERCEPTRON_MAX_HISTORY 1024
+#define PERCEPTRON_MAX_ROWS    (1 << 16)
+
+// Width of a weight, including the sign
+#define PERCEPTRON_WEIGHT_BITS 8
+
+typedef struct perceptron perceptron_t;
+
+// Returns True if the perceptron geometry in 'cfg' is valid
+//
+int perceptron_valid_config(const bp_config_t* cfg);
+
+// Create a perceptron predictor with the geometry in 'cfg', using the
+// widest dot product kernel the CPU supports
+//
+// Returns NULL if the geometry is invalid
+//
+perceptron_t* perceptron_create(const bp_config_t* cfg);
+
+// Get the name of the kernel ("avx2", "sse4.1" or "scalar") used by 'p'
+//
+const char* perceptron_kernel(const perceptron_t* p);
+
+// Return the predictor to its initial state
+//
+void perceptron_reset(perceptron_t* p);
+
+// Predict the branch at PC 'pc', filling 'rec' with the weight row and
+// the perceptron output. Lookups do not change the predictor.
+//
+uint8_t perceptron_lookup(perceptron_t* p, uint32_t pc, bp_lookup_t* rec);
+
+// Returns True if the output in 'rec' is within the training threshold
+//
+int perceptron_weak(const perceptron_t* p, const bp_lookup_t* rec);
+
+// Train on a misprediction or an output below the threshold, and shift
+// the outcome into the history
+//
+void perceptron_update(perceptron_t* p, const bp_lookup_t* rec,
+                       uint8_t outcome);
+
+// Visit the weights and history of the predictor
+//
+void perceptron_state(perceptron_t* p, bp_state_t* s);
+
+void perceptron_destroy(perceptron_t* p);
+
+#endif
@@ -0,0 +1,167 @@
+//========================================================//
+//  pool.c                                                //
+//  Source file for the work-stealing thread pool         //
+//                                                        //
+//  Every worker owns a deque of job indices, taking work //
+//  from its bottom and stealing from the top of others   //
+//========================================================//
+
+#define _GNU_SOURCE
+#include "pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// The deque of a worker. Jobs are handed out in index order, so the
+// deque is the range [top, bottom) of job indices.
+typedef struct
+{
+    pthread_mutex_t lock;
+    int top;
+    int bottom;
+} deque_t;
+
+typedef struct
+{
+    deque_t* deques;
+    int num_workers;
+    pool_job_t job;
+    void* arg;
+} pool_t;
+
+typedef struct
+{
+    pool_t* pool;
+    int id;
+} worker_t;
+
+// Take the next job from the bottom of the worker's own deque
+//
+// Returns the job, or -1 if the deque is empty
+//
+static int pop_job(deque_t* dq)
+{
+    int job = -1;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->top < dq->bottom)
+    {
+        job = --dq->bottom;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return job;
+}
+
+// Steal half of the jobs left at the top of 'victim' into 'dq'
+//
+// Returns True if any job was stolen
+//
+static int steal_jobs(deque_t* dq, deque_t* victim)
+{
+    int top, bottom;
+
+    pthread_mutex_lock(&victim->lock);
+    int left = victim->bottom - victim->top;
+    top = victim->top;
+    bottom = top + (left + 1) / 2;
+    victim->top = bottom;
+    pthread_mutex_unlock(&victim->lock);
+
+    if (left <= 0)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&dq->lock);
+    dq->top = top;
+    dq->bottom = bottom;
+    pthread_mutex_unlock(&dq->lock);
+    return 1;
+}
+
+static void* worker_main(void* arg)
+{
+    worker_t* w = (worker_t*)arg;
+    pool_t* pool = w->pool;
+    deque_t* dq = &pool->deques[w->id];
+
+    while (1)
+    {
+        int job;
+        while ((job = pop_job(dq)) >= 0)
+        {
+            pool->job(pool->arg, job);
+        }
+
+        // look for a victim, starting with the next worker
+        int stolen = 0;
+        for (int i = 1; i < pool->num_workers && !stolen; i++)
+        {
+            int victim = (w->id + i) % pool->num_workers;
+            stolen = steal_jobs(dq, &pool->deques[victim]);
+        }
+        if (!stolen)
+        {
+            // jobs are never added, so empty deques everywhere mean done
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+int pool_default_threads()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+void pool_run(int num_jobs, int num_threads, pool_job_t job, void* arg)
+{
+    if (num_threads > num_jobs)
+    {
+        num_threads = num_jobs;
+    }
+    if (num_threads <= 1)
+    {
+        for (int i = 0; i < num_jobs; i++)
+        {
+            job(arg, i);
+        }
+        return;
+    }
+
+    pool_t pool;
+    pool.deques = (deque_t*)malloc(num_threads * sizeof(deque_t));
+    pool.num_workers = num_threads;
+    pool.job = job;
+    pool.arg = arg;
+
+    // start every worker with an even share of the jobs
+    for (int i = 0; i < num_threads; i++)
+    {
+        pthread_mutex_init(&pool.deques[i].lock, NULL);
+        pool.deques[i].top = (int)((long)num_jobs * i / num_threads);
+        pool.deques[i].bottom = (int)((long)num_jobs * (i + 1) / num_threads);
+    }
+
+    pthread_t* threads = (pthread_t*)malloc(num_threads * sizeof(pthread_t));
+    worker_t* workers = (worker_t*)malloc(num_threads * sizeof(worker_t));
+    for (int i = 0; i < num_threads; i++)
+    {
+        workers[i].pool = &pool;
+        workers[i].id = i;
+        pthread_create(&threads[i], NULL, worker_main, &workers[i]);
+    }
+    for (int i = 0; i < num_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (int i = 0; i < num_threads; i++)
+    {
+        pthread_mutex_destroy(&pool.deques[i].lock);
+    }
+    free(workers);
+    free(threads);
+    free(pool.deques);
+}
@@ -0,0 +1,26 @@
+//========================================================//
+//  pool.h                                                //
+//  Header file for the work-stealing thread pool         //
+//                                                        //
+//  Runs a fixed set of independent jobs across cores     //
+//========================================================//
+
+#ifndef POOL_H
+#define POOL_H
+
+// A job of the pool, called with the 'arg' given to pool_run() and the
+// index of the job
+typedef void (*pool_job_t)(void* arg, int job);
+
+// Get the default number of worker threads, the number of online cores
+//
+int pool_default_threads();
+
+// Run jobs 0 .. num_jobs-1 on up to 'num_threads' threads and wait for
+// all of them to finish. Each worker starts with an even share of the
+// jobs and steals half of the remaining jobs of another worker when it
+// runs out, so uneven job lengths still keep every core busy.
+//
+void pool_run(int num_jobs, int num_threads, pool_job_t job, void* arg);
+
+#endif
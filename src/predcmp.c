@@ -0,0 +1,102 @@
+//========================================================//
+//  predcmp.c                                             //
+//  Prediction stream compare tool                        //
+//                                                        //
+//  Compares two streams written with --predictions and   //
+//  reports where and how often they diverge              //
+//========================================================//
+
+#include "predstream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Print out the Usage information to stderr
+//
+void usage()
+{
+    fprintf(stderr, "Usage: predcmp <stream> <stream>\n");
+    fprintf(stderr, " Compares two prediction streams written by\n"
+                    " predictor --predictions <file>. Exits with 0 when\n"
+                    " they are identical, 1 when they differ and 2 on\n"
+                    " error.\n");
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3 || !strcmp(argv[1], "--help"))
+    {
+        usage();
+        exit(2);
+    }
+
+    predstream_map_t a, b;
+    if (!predstream_map(argv[1], &a))
+    {
+        exit(2);
+    }
+    if (!predstream_map(argv[2], &b))
+    {
+        exit(2);
+    }
+
+    uint32_t preds = a.hdr->num_predictors;
+    if (preds != b.hdr->num_predictors)
+    {
+        printf("Predictors differ: %u vs %u\n", preds,
+               b.hdr->num_predictors);
+    }
+    if (a.num_predictions != b.num_predictions)
+    {
+        printf("Predictions differ: %llu vs %llu\n",
+               (unsigned long long)a.num_predictions,
+               (unsigned long long)b.num_predictions);
+    }
+
+    // compare the common prefix a word at a time, the unused bits of the
+    // last word are zero in both
+    uint64_t n = a.num_predictions < b.num_predictions ? a.num_predictions
+                                                       : b.num_predictions;
+    uint64_t differ = 0;
+    uint64_t first = UINT64_MAX;
+    for (uint64_t w = 0; w < (n + 63) / 64; w++)
+    {
+        uint64_t x = a.words[w] ^ b.words[w];
+        if (w == n / 64)
+        {
+            // the shorter stream ends within this word
+            x &= (1ULL << (n % 64)) - 1;
+        }
+        if (x != 0)
+        {
+            if (first == UINT64_MAX)
+            {
+                first = w * 64 + __builtin_ctzll(x);
+            }
+            differ += __builtin_popcountll(x);
+        }
+    }
+
+    printf("Compared:          %10llu predictions\n", (unsigned long long)n);
+    printf("Differing:         %10llu\n", (unsigned long long)differ);
+    if (first != UINT64_MAX)
+    {
+        if (preds > 0)
+        {
+            printf("First divergence:  %10llu (branch %llu, predictor %u)\n",
+                   (unsigned long long)first,
+                   (unsigned long long)(first / preds),
+                   (unsigned)(first % preds));
+        }
+        else
+        {
+            printf("First divergence:  %10llu\n", (unsigned long long)first);
+        }
+    }
+
+    int same = differ == 0 && a.num_predictions == b.num_predictions &&
+               preds == b.hdr->num_predictors;
+    predstream_unmap(&a);
+    predstream_unmap(&b);
+    return same ? 0 : 1;
+}
@@ -5,10 +5,18 @@
 //  Implement the various branch predictors below as      //
 //  described in the README                               //
 //========================================================//
+#define _GNU_SOURCE
 #include "predictor.h"
+#include "corrector.h"
+#include "counters.h"
+#include "loop.h"
+#include "perceptron.h"
+#include "state.h"
+#include "tage.h"
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 
 //
 // TODO:Student Information
@@ -62,33 +70,26 @@ uint8_t PREDICT(uint8_t a)
 //------------------------------------//
 
 // Handy Global for use in output routines
-const char* bpName[4] = {"Static", "Gshare", "Tournament", "Custom"};
+const char* bpName[NUM_TYPES] = {"Static", "Gshare", "Tournament", "Custom",
+                                 "TAGE",   "Perceptron"};
 
 // define number of bits required for indexing the BHT here.
 int ghistoryBits = 14; // Number of bits used for Global History
+int lhistoryBits = 10; // Number of bits used for Local History
+int pcIndexBits = 11;  // Number of bits used for PC index
 int bpType;            // Branch Prediction Type
 int verbose;
 
+// Instance used by the init_predictor() / make_prediction() /
+// train_predictor() interface
+static predictor_t* default_predictor;
+
 // tournament
-const int trn_pcBits = 11;        // PC register size (effective size for BP)
-const int trn_ghr_bBits = 12;     // global bht index size
-const int trn_ghr_cBits = 11;     // chooser index size
-const int trn_local_phtBits = 10; // local predictor pht entry size
+// Table sizes are part of bp_config_t, only the counter widths are fixed
 const int trn_local_bhtBits = 2;  // local predictor bht entry size
 const int trn_global_bhtBits = 2; // global preictor bht entry size
 const int trn_chooserBits = 3;    // chooser entry size
 
-const int trn_local_phtSize = 1 << 11; // local predictor pht # entries
-const int trn_global_bhtSize = 1 << 12;
-const int trn_chooserSize = 1 << 11;
-const int trn_local_bhtSize = 1 << 10;
-
-// const int trn_local_phtSize = 1 << trn_pcBits;
-// local predictor pht # entries
-// const int trn_local_bhtSize = 1 << trn_local_phtBits;
-// const int trn_global_bhtSize = 1 << trn_ghr_bBits;
-// const int trn_chooserSize = 1 << trn_ghr_cBits;
-
 // custom
 
 //------------------------------------//
@@ -98,62 +99,100 @@ const int trn_local_bhtSize = 1 << 10;
 //
 // TODO: Add your own Branch Predictor data structures here
 //
-// gshare
-uint8_t* bht_gshare;
-uint64_t ghistory;
+// All state lives in the instance so that predictors are reentrant. The
+// tables are bit-packed at the width of their entries (see counters.h).
+typedef uint64_t (*bp_run_t)(predictor_t* p, const uint32_t* pc,
+                              uint64_t taken, int count);
 
-// tournament
-uint16_t* trn_local_pht;
-uint8_t* trn_local_bht;
-uint8_t* trn_global_bht;
-uint8_t* trn_chooser;
+struct predictor
+{
+    bp_config_t cfg;
+    uint64_t ghistory;
+
+    // gshare
+    packed_t bht_gshare;
+
+    // tournament and custom
+    uint32_t trn_local_phtSize;  // local predictor pht # entries
+    uint32_t trn_local_bhtSize;  // local predictor bht # entries
+    uint32_t trn_global_bhtSize; // global predictor bht # entries
+    uint32_t trn_chooserSize;    // chooser # entries
+    packed_t trn_local_pht;
+    packed_t trn_local_bht;
+    packed_t trn_global_bht;
+    packed_t trn_chooser;
+
+    // tage
+    tage_t* tage;
+
+    // perceptron
+    perceptron_t* perceptron;
+
+    // side components, NULL when left out
+    loop_t* loop;
+    corrector_t* sc;
+    bp_side_stats_t side;
+
+    // simulation loop, picked for the type and geometry
+    bp_run_t run;
+};
 
 //------------------------------------//
 //        Predictor Functions         //
 //------------------------------------//
 
 // gshare functions
-void init_gshare();
-uint8_t gshare_predict(uint32_t pc);
-void train_gshare(uint32_t pc, uint8_t outcome);
-void cleanup_gshare();
+void init_gshare(predictor_t* p);
+void reset_gshare(predictor_t* p);
+uint8_t gshare_predict(predictor_t* p, uint32_t pc);
+void train_gshare(predictor_t* p, uint32_t pc, uint8_t outcome);
+uint8_t gshare_lookup(predictor_t* p, uint32_t pc, bp_lookup_t* rec);
+void update_gshare(predictor_t* p, const bp_lookup_t* rec, uint8_t outcome);
+void cleanup_gshare(predictor_t* p);
 
 // tournament functions
-void init_tournament();
-uint8_t tournament_predict(uint32_t pc);
-void train_tournament(uint32_t pc, uint8_t outcome);
-void cleanup_tournament();
+void init_tournament(predictor_t* p);
+void reset_tournament(predictor_t* p);
+uint8_t tournament_predict(predictor_t* p, uint32_t pc);
+void train_tournament(predictor_t* p, uint32_t pc, uint8_t outcome);
+uint8_t tournament_lookup(predictor_t* p, uint32_t pc, bp_lookup_t* rec);
+void update_tournament(predictor_t* p, const bp_lookup_t* rec,
+                       uint8_t outcome);
+void cleanup_tournament(predictor_t* p);
 
 // custom functions
-void init_custom();
-uint8_t custom_predict(uint32_t pc);
-void train_custom(uint32_t pc, uint8_t outcome);
-void cleanup_custom();
+void init_custom(predictor_t* p);
+void reset_custom(predictor_t* p);
+uint8_t custom_predict(predictor_t* p, uint32_t pc);
+void train_custom(predictor_t* p, uint32_t pc, uint8_t outcome);
+uint8_t custom_lookup(predictor_t* p, uint32_t pc, bp_lookup_t* rec);
+void cleanup_custom(predictor_t* p);
 
 // Initialize the predictor
 //
 
 // gshare functions
-void init_gshare()
+void init_gshare(predictor_t* p)
 {
-    int bht_entries = 1 << ghistoryBits;
-    bht_gshare = (uint8_t*)malloc(bht_entries * sizeof(uint8_t));
-    int i = 0;
-    for (i = 0; i < bht_entries; i++)
-    {
-        bht_gshare[i] = WN;
-    }
-    ghistory = 0;
+    int bht_entries = 1 << p->cfg.ghistoryBits;
+    packed_init(&p->bht_gshare, bht_entries, 2);
+    reset_gshare(p);
+}
+
+void reset_gshare(predictor_t* p)
+{
+    packed_fill(&p->bht_gshare, WN);
+    p->ghistory = 0;
 }
 
-uint8_t gshare_predict(uint32_t pc)
+uint8_t gshare_predict(predictor_t* p, uint32_t pc)
 {
     // get lower ghistoryBits of pc
-    uint32_t bht_entries = 1 << ghistoryBits;
+    uint32_t bht_entries = 1 << p->cfg.ghistoryBits;
     uint32_t pc_lower_bits = pc & (bht_entries - 1);
-    uint32_t ghistory_lower_bits = ghistory & (bht_entries - 1);
+    uint32_t ghistory_lower_bits = p->ghistory & (bht_entries - 1);
     uint32_t index = pc_lower_bits ^ ghistory_lower_bits;
-    switch (bht_gshare[index])
+    switch (packed_get(&p->bht_gshare, index))
     {
     case WN:
         return NOTTAKEN;
@@ -169,339 +208,1406 @@ uint8_t gshare_predict(uint32_t pc)
     }
 }
 
-void train_gshare(uint32_t pc, uint8_t outcome)
+void train_gshare(predictor_t* p, uint32_t pc, uint8_t outcome)
 {
     // get lower ghistoryBits of pc
-    uint32_t bht_entries = 1 << ghistoryBits;
+    uint32_t bht_entries = 1 << p->cfg.ghistoryBits;
     uint32_t pc_lower_bits = pc & (bht_entries - 1);
-    uint32_t ghistory_lower_bits = ghistory & (bht_entries - 1);
+    uint32_t ghistory_lower_bits = p->ghistory & (bht_entries - 1);
     uint32_t index = pc_lower_bits ^ ghistory_lower_bits;
 
     // Update state of entry in bht based on outcome
-    switch (bht_gshare[index])
+    switch (packed_get(&p->bht_gshare, index))
     {
     case WN:
-        bht_gshare[index] = (outcome == TAKEN) ? WT : SN;
+        packed_set(&p->bht_gshare, index, (outcome == TAKEN) ? WT : SN);
         break;
     case SN:
-        bht_gshare[index] = (outcome == TAKEN) ? WN : SN;
+        packed_set(&p->bht_gshare, index, (outcome == TAKEN) ? WN : SN);
         break;
     case WT:
-        bht_gshare[index] = (outcome == TAKEN) ? ST : WN;
+        packed_set(&p->bht_gshare, index, (outcome == TAKEN) ? ST : WN);
         break;
     case ST:
-        bht_gshare[index] = (outcome == TAKEN) ? ST : WT;
+        packed_set(&p->bht_gshare, index, (outcome == TAKEN) ? ST : WT);
         break;
     default:
         printf("Warning: Undefined state of entry in GSHARE BHT!\n");
     }
 
     // Update history register
-    ghistory = ((ghistory << 1) | outcome);
+    p->ghistory = ((p->ghistory << 1) | outcome);
 }
 
-void cleanup_gshare()
+void cleanup_gshare(predictor_t* p)
 {
-    free(bht_gshare);
+    packed_free(&p->bht_gshare);
 }
 
 // tournament functions
-void init_tournament()
+void init_tournament(predictor_t* p)
 {
-    trn_local_pht = (uint16_t*)malloc(trn_local_phtSize * sizeof(uint16_t));
-    trn_local_bht = (uint8_t*)malloc(trn_local_bhtSize * sizeof(uint8_t));
-    trn_global_bht = (uint8_t*)malloc(trn_global_bhtSize * sizeof(uint8_t));
-    trn_chooser = (uint8_t*)malloc(trn_chooserSize * sizeof(uint8_t));
+    p->trn_local_phtSize = 1 << p->cfg.pcIndexBits;
+    p->trn_local_bhtSize = 1 << p->cfg.lhistoryBits;
+    p->trn_global_bhtSize = 1 << p->cfg.ghistoryBits;
+    p->trn_chooserSize = 1 << p->cfg.chooserBits;
 
-    memset(trn_local_pht, 0, trn_local_phtSize * sizeof(uint16_t));
-    memset(trn_local_bht, WT, trn_local_bhtSize);
-    memset(trn_global_bht, WT, trn_global_bhtSize);
-    memset(trn_chooser, WT, trn_chooserSize);
+    // local histories are kept at exactly lhistoryBits
+    packed_init(&p->trn_local_pht, p->trn_local_phtSize, p->cfg.lhistoryBits);
+    packed_init(&p->trn_local_bht, p->trn_local_bhtSize, trn_local_bhtBits);
+    packed_init(&p->trn_global_bht, p->trn_global_bhtSize, trn_global_bhtBits);
+    packed_init(&p->trn_chooser, p->trn_chooserSize, trn_chooserBits);
+    reset_tournament(p);
 }
 
-uint8_t tournament_predict(uint32_t pc)
+void reset_tournament(predictor_t* p)
 {
-    uint8_t prediction;
+    p->ghistory = 0;
+    packed_fill(&p->trn_local_pht, 0);
+    packed_fill(&p->trn_local_bht, WT);
+    packed_fill(&p->trn_global_bht, WT);
+    packed_fill(&p->trn_chooser, WT);
+}
 
+uint8_t tournament_predict(predictor_t* p, uint32_t pc)
+{
     // choose local or global
-    uint16_t ghr_c = ghistory & (trn_chooserSize - 1);
-    uint16_t ghr_b = ghistory & (trn_global_bhtSize - 1);
-    // uint8_t choice = PREDICT(trn_chooser[ghr]);
-    uint8_t choice =
-        trn_chooser[ghr_c] >> (trn_chooserBits - 1) ? TAKEN : NOTTAKEN;
+    uint32_t ghr_c = p->ghistory & (p->trn_chooserSize - 1);
+    uint32_t ghr_b = p->ghistory & (p->trn_global_bhtSize - 1);
+    uint8_t choice = packed_msb(&p->trn_chooser, ghr_c) ? TAKEN : NOTTAKEN;
 
     if (choice == TAKEN)
     {
         // global predictor (1)
         // get prediction based on ghr
-        // return PREDICT(trn_global_bht[ghr]);
-        return trn_global_bht[ghr_b] >> (trn_global_bhtBits - 1) ? TAKEN
-                                                                 : NOTTAKEN;
+        return packed_msb(&p->trn_global_bht, ghr_b) ? TAKEN : NOTTAKEN;
     }
     else
     {
         // local predictor (0)
-        uint16_t pc_idx = pc & (trn_local_phtSize - 1);
+        uint32_t pc_idx = pc & (p->trn_local_phtSize - 1);
         // get pattern of branch
-        uint16_t pat = (trn_local_pht[pc_idx]) & (trn_local_bhtSize - 1);
+        uint32_t pat = packed_get(&p->trn_local_pht, pc_idx);
         // get prediction based on pattern
-        // return PREDICT(trn_local_bht[pat]);
-        return trn_local_bht[pat] >> (trn_local_bhtBits - 1) ? TAKEN : NOTTAKEN;
+        return packed_msb(&p->trn_local_bht, pat) ? TAKEN : NOTTAKEN;
     }
-
-    // return prediction ? TAKEN : NOTTAKEN;
 }
 
-void train_tournament(uint32_t pc, uint8_t outcome)
+void train_tournament(predictor_t* p, uint32_t pc, uint8_t outcome)
 {
     uint8_t global_pred;
     uint8_t local_pred;
-    uint8_t choice;
 
     // choose local or global
-    uint16_t ghr_c = ghistory & (trn_chooserSize - 1);
-    uint16_t ghr_b = ghistory & (trn_global_bhtSize - 1);
-    // choice = PREDICT(trn_chooser[ghr]);
-    choice = trn_chooser[ghr_c] >> (trn_chooserBits - 1) ? TAKEN : NOTTAKEN;
+    uint32_t ghr_c = p->ghistory & (p->trn_chooserSize - 1);
+    uint32_t ghr_b = p->ghistory & (p->trn_global_bhtSize - 1);
 
     // global predictor (1)
-    // global_pred = PREDICT(trn_global_bht[ghr]);
-    global_pred =
-        trn_global_bht[ghr_b] >> (trn_global_bhtBits - 1) ? TAKEN : NOTTAKEN;
+    global_pred = packed_msb(&p->trn_global_bht, ghr_b) ? TAKEN : NOTTAKEN;
 
     // local predictor (0)
-    uint16_t pc_idx = pc & (trn_local_phtSize - 1);
-    uint16_t pat = (trn_local_pht[pc_idx]) & (trn_local_bhtSize - 1);
-    // local_pred = PREDICT(trn_local_bht[pat]);
-    local_pred =
-        trn_local_bht[pat] >> (trn_local_bhtBits - 1) ? TAKEN : NOTTAKEN;
+    uint32_t pc_idx = pc & (p->trn_local_phtSize - 1);
+    uint32_t pat = packed_get(&p->trn_local_pht, pc_idx);
+    local_pred = packed_msb(&p->trn_local_bht, pat) ? TAKEN : NOTTAKEN;
 
     // update tables
     // only update choice if predictions differ
     if (global_pred != local_pred)
     {
-        // TRAIN(trn_chooser[ghr], (outcome == global_pred ? TAKEN : NOTTAKEN))
-        if (global_pred == outcome)
-        {
-            trn_chooser[ghr_c] =
-                MIN(trn_chooser[ghr_c] + 1, (1 << trn_chooserBits) - 1);
-        }
-        else if (local_pred == outcome)
-        {
-            trn_chooser[ghr_c] = MAX(trn_chooser[ghr_c], 1) - 1;
-        }
+        // count towards the component that was right
+        packed_count(&p->trn_chooser, ghr_c, global_pred == outcome);
     }
 
     // ghr and pattern table
-    ghistory = ((ghistory << 1) | (outcome & 0x1));
-    trn_local_pht[pc_idx] = ((trn_local_pht[pc_idx] << 1) | (outcome & 0x1));
+    p->ghistory = ((p->ghistory << 1) | (outcome & 0x1));
+    packed_shift(&p->trn_local_pht, pc_idx, outcome);
 
     // branch history tables
-    // TRAIN(trn_global_bht[ghr], outcome)
-    if (outcome == TAKEN)
-        trn_global_bht[ghr_b] =
-            MIN(trn_global_bht[ghr_b] + 1, (1 << trn_global_bhtBits) - 1);
-    else
-        trn_global_bht[ghr_b] = MAX(trn_global_bht[ghr_b], 1) - 1;
-
-    // TRAIN(trn_local_bht[pat], outcome)
-    if (outcome == TAKEN)
-        trn_local_bht[pat] =
-            MIN(trn_local_bht[pat] + 1, (1 << trn_local_bhtBits) - 1);
-    else
-        trn_local_bht[pat] = MAX(trn_local_bht[pat], 1) - 1;
+    packed_count(&p->trn_global_bht, ghr_b, outcome == TAKEN);
+    packed_count(&p->trn_local_bht, pat, outcome == TAKEN);
 }
 
-void cleanup_tournament()
+void cleanup_tournament(predictor_t* p)
 {
-    /*
-    for (int i = 0; i < trn_local_bhtSize; i++)
-    {
-        uint16_t entry = trn_local_bht[i];
-        printf("%03X: ", i);
-        for (int j = 7; j >= 0; j--)
-        {
-            int bit = (entry >> j) & 0x1;
-            printf("%i", bit);
-        }
-        printf("\n");
-    }
-    */
-    free(trn_local_pht);
-    free(trn_local_bht);
-    free(trn_global_bht);
-    free(trn_chooser);
+    packed_free(&p->trn_local_pht);
+    packed_free(&p->trn_local_bht);
+    packed_free(&p->trn_global_bht);
+    packed_free(&p->trn_chooser);
 }
 
 // custom functions
-void init_custom()
+void init_custom(predictor_t* p)
 {
-    trn_local_pht = (uint16_t*)malloc(trn_local_phtSize * sizeof(uint16_t));
-    trn_local_bht = (uint8_t*)malloc(trn_local_bhtSize * sizeof(uint8_t));
-    trn_global_bht = (uint8_t*)malloc(trn_global_bhtSize * sizeof(uint8_t));
-    trn_chooser = (uint8_t*)malloc(trn_chooserSize * sizeof(uint8_t));
-
-    memset(trn_local_pht, 0, trn_local_phtSize * sizeof(uint16_t));
-    memset(trn_local_bht, WT, trn_local_bhtSize);
-    memset(trn_global_bht, WT, trn_global_bhtSize);
-    memset(trn_chooser, WT, trn_chooserSize);
+    init_tournament(p);
 }
 
-uint8_t custom_predict(uint32_t pc)
+void reset_custom(predictor_t* p)
 {
-    uint8_t prediction;
+    reset_tournament(p);
+}
 
+uint8_t custom_predict(predictor_t* p, uint32_t pc)
+{
     // choose local or global
-    uint16_t ghr_c = ghistory & (trn_chooserSize - 1);
-    uint16_t ghr_b = (ghistory ^ pc) & (trn_global_bhtSize - 1);
-    // uint8_t choice = PREDICT(trn_chooser[ghr]);
-    uint8_t choice =
-        trn_chooser[ghr_c] >> (trn_chooserBits - 1) ? TAKEN : NOTTAKEN;
+    uint32_t ghr_c = p->ghistory & (p->trn_chooserSize - 1);
+    uint32_t ghr_b = (p->ghistory ^ pc) & (p->trn_global_bhtSize - 1);
+    uint8_t choice = packed_msb(&p->trn_chooser, ghr_c) ? TAKEN : NOTTAKEN;
 
     if (choice == TAKEN)
     {
         // global predictor (1)
-        // get prediction based on ghr
-        // return PREDICT(trn_global_bht[ghr]);
-        return trn_global_bht[ghr_b] >> (trn_global_bhtBits - 1) ? TAKEN
-                                                                 : NOTTAKEN;
+        // get prediction based on ghr xor pc
+        return packed_msb(&p->trn_global_bht, ghr_b) ? TAKEN : NOTTAKEN;
     }
     else
     {
         // local predictor (0)
-        uint16_t pc_idx = pc & (trn_local_phtSize - 1);
+        uint32_t pc_idx = pc & (p->trn_local_phtSize - 1);
         // get pattern of branch
-        uint16_t pat = (trn_local_pht[pc_idx]) & (trn_local_bhtSize - 1);
+        uint32_t pat = packed_get(&p->trn_local_pht, pc_idx);
         // get prediction based on pattern
-        // return PREDICT(trn_local_bht[pat]);
-        return trn_local_bht[pat] >> (trn_local_bhtBits - 1) ? TAKEN : NOTTAKEN;
+        return packed_msb(&p->trn_local_bht, pat) ? TAKEN : NOTTAKEN;
     }
 }
 
-void train_custom(uint32_t pc, uint8_t outcome)
+void train_custom(predictor_t* p, uint32_t pc, uint8_t outcome)
 {
     uint8_t global_pred;
     uint8_t local_pred;
-    uint8_t choice;
 
     // choose local or global
-    uint16_t ghr_c = (ghistory) & (trn_chooserSize - 1);
-    uint16_t ghr_b = (ghistory ^ pc) & (trn_global_bhtSize - 1);
-    // choice = PREDICT(trn_chooser[ghr]);
-    choice = trn_chooser[ghr_c] >> (trn_chooserBits - 1) ? TAKEN : NOTTAKEN;
+    uint32_t ghr_c = (p->ghistory) & (p->trn_chooserSize - 1);
+    uint32_t ghr_b = (p->ghistory ^ pc) & (p->trn_global_bhtSize - 1);
 
     // global predictor (1)
-    // global_pred = PREDICT(trn_global_bht[ghr]);
-    global_pred =
-        trn_global_bht[ghr_b] >> (trn_global_bhtBits - 1) ? TAKEN : NOTTAKEN;
+    global_pred = packed_msb(&p->trn_global_bht, ghr_b) ? TAKEN : NOTTAKEN;
 
     // local predictor (0)
-    uint16_t pc_idx = pc & (trn_local_phtSize - 1);
-    uint16_t pat = (trn_local_pht[pc_idx]) & (trn_local_bhtSize - 1);
-    // local_pred = PREDICT(trn_local_bht[pat]);
-    local_pred =
-        trn_local_bht[pat] >> (trn_local_bhtBits - 1) ? TAKEN : NOTTAKEN;
+    uint32_t pc_idx = pc & (p->trn_local_phtSize - 1);
+    uint32_t pat = packed_get(&p->trn_local_pht, pc_idx);
+    local_pred = packed_msb(&p->trn_local_bht, pat) ? TAKEN : NOTTAKEN;
 
     // update tables
     // only update choice if predictions differ
     if (global_pred != local_pred)
     {
-        // TRAIN(trn_chooser[ghr], (outcome == global_pred ? TAKEN : NOTTAKEN))
-        if (global_pred == outcome)
-        {
-            trn_chooser[ghr_c] =
-                MIN(trn_chooser[ghr_c] + 1, (1 << trn_chooserBits) - 1);
-        }
-        else if (local_pred == outcome)
-        {
-            trn_chooser[ghr_c] = MAX(trn_chooser[ghr_c], 1) - 1;
-        }
+        // count towards the component that was right
+        packed_count(&p->trn_chooser, ghr_c, global_pred == outcome);
     }
 
     // ghr and pattern table
-    ghistory = ((ghistory << 1) | (outcome & 0x1));
-    trn_local_pht[pc_idx] = ((trn_local_pht[pc_idx] << 1) | (outcome & 0x1));
+    p->ghistory = ((p->ghistory << 1) | (outcome & 0x1));
+    packed_shift(&p->trn_local_pht, pc_idx, outcome);
 
     // branch history tables
-    // TRAIN(trn_global_bht[ghr], outcome)
-    if (outcome == TAKEN)
-        trn_global_bht[ghr_b] =
-            MIN(trn_global_bht[ghr_b] + 1, (1 << trn_global_bhtBits) - 1);
-    else
-        trn_global_bht[ghr_b] = MAX(trn_global_bht[ghr_b], 1) - 1;
+    packed_count(&p->trn_global_bht, ghr_b, outcome == TAKEN);
+    packed_count(&p->trn_local_bht, pat, outcome == TAKEN);
+}
 
-    // TRAIN(trn_local_bht[pat], outcome)
-    if (outcome == TAKEN)
-        trn_local_bht[pat] =
-            MIN(trn_local_bht[pat] + 1, (1 << trn_local_bhtBits) - 1);
-    else
-        trn_local_bht[pat] = MAX(trn_local_bht[pat], 1) - 1;
+void cleanup_custom(predictor_t* p)
+{
+    cleanup_tournament(p);
 }
 
-void init_predictor()
+//------------------------------------//
+//      Fused Lookup and Update       //
+//------------------------------------//
+
+// These compute every index and read every table entry once in the
+// lookup, and the update trains from the lookup record instead of
+// repeating the work. They give exactly the predictions and table
+// updates of the predict/train functions above.
+
+uint8_t gshare_lookup(predictor_t* p, uint32_t pc, bp_lookup_t* rec)
+{
+    uint32_t mask = (1 << p->cfg.ghistoryBits) - 1;
+    rec->index = (pc ^ p->ghistory) & mask;
+    rec->prediction = packed_msb(&p->bht_gshare, rec->index);
+    return rec->prediction;
+}
+
+void update_gshare(predictor_t* p, const bp_lookup_t* rec, uint8_t outcome)
+{
+    packed_count(&p->bht_gshare, rec->index, outcome == TAKEN);
+    p->ghistory = ((p->ghistory << 1) | outcome);
+}
+
+// Look up both components and the chooser, with the global BHT index
+// already in rec->index
+//
+static inline uint8_t trn_lookup(predictor_t* p, uint32_t pc,
+                                 bp_lookup_t* rec)
+{
+    rec->chooser = p->ghistory & (p->trn_chooserSize - 1);
+    rec->pc_idx = pc & (p->trn_local_phtSize - 1);
+    rec->pat = packed_get(&p->trn_local_pht, rec->pc_idx);
+
+    rec->global_pred = packed_msb(&p->trn_global_bht, rec->index);
+    rec->local_pred = packed_msb(&p->trn_local_bht, rec->pat);
+
+    uint8_t choice = packed_msb(&p->trn_chooser, rec->chooser);
+    rec->prediction = choice ? rec->global_pred : rec->local_pred;
+    return rec->prediction;
+}
+
+uint8_t tournament_lookup(predictor_t* p, uint32_t pc, bp_lookup_t* rec)
+{
+    rec->index = p->ghistory & (p->trn_global_bhtSize - 1);
+    return trn_lookup(p, pc, rec);
+}
+
+uint8_t custom_lookup(predictor_t* p, uint32_t pc, bp_lookup_t* rec)
+{
+    rec->index = (p->ghistory ^ pc) & (p->trn_global_bhtSize - 1);
+    return trn_lookup(p, pc, rec);
+}
+
+// Shared by tournament and custom, which only differ in the lookup
+void update_tournament(predictor_t* p, const bp_lookup_t* rec,
+                       uint8_t outcome)
 {
-    switch (bpType)
+    // only update choice if predictions differ
+    if (rec->global_pred != rec->local_pred)
+    {
+        packed_count(&p->trn_chooser, rec->chooser,
+                     rec->global_pred == outcome);
+    }
+
+    // ghr and pattern table
+    p->ghistory = ((p->ghistory << 1) | (outcome & 0x1));
+    packed_shift(&p->trn_local_pht, rec->pc_idx, outcome);
+
+    // branch history tables
+    packed_count(&p->trn_global_bht, rec->index, outcome == TAKEN);
+    packed_count(&p->trn_local_bht, rec->pat, outcome == TAKEN);
+}
+
+//------------------------------------//
+//         Side Components            //
+//------------------------------------//
+
+// The loop predictor and the statistical corrector wrap a base
+// predictor of any type, which predicts and trains as it would alone.
+// The corrector may overturn the base predictions made with low
+// confidence, then the loop predictor has the last word on the loops it
+// is sure of.
+
+static inline int has_side(const bp_config_t* cfg)
+{
+    return cfg->loopBits > 0 || cfg->scBits > 0;
+}
+
+// Returns True if the base prediction in 'rec' was made with low
+// confidence
+//
+static int base_weak(const predictor_t* p, const bp_lookup_t* rec)
+{
+    switch (p->cfg.bpType)
     {
-    case STATIC:
-        break;
     case GSHARE:
-        init_gshare();
-        break;
+    {
+        uint32_t ctr = packed_get(&p->bht_gshare, rec->index);
+        return ctr == WN || ctr == WT;
+    }
     case TOURNAMENT:
-        init_tournament();
-        break;
     case CUSTOM:
-        init_custom();
+    {
+        // the components disagree, or agree with weak counters
+        uint32_t g = packed_get(&p->trn_global_bht, rec->index);
+        uint32_t l = packed_get(&p->trn_local_bht, rec->pat);
+        return rec->global_pred != rec->local_pred ||
+               ((g == WN || g == WT) && (l == WN || l == WT));
+    }
+    case TAGE:
+        return tage_weak(p->tage, rec);
+    case PERCEPTRON:
+        return perceptron_weak(p->perceptron, rec);
     default:
-        break;
+        // static predictions carry no confidence
+        return 1;
     }
 }
 
-// Make a prediction for conditional branch instruction at PC 'pc'
-// Returning TAKEN indicates a prediction of taken; returning NOTTAKEN
-// indicates a prediction of not taken
+// Pass the base prediction in 'rec' through the side components
 //
-uint8_t make_prediction(uint32_t pc)
+static void side_lookup(predictor_t* p, uint32_t pc, bp_lookup_t* rec)
 {
+    if (p->sc != NULL)
+    {
+        rec->prediction = corrector_lookup(p->sc, pc, rec->prediction,
+                                           base_weak(p, rec));
+    }
+    rec->corrected = rec->prediction;
 
-    // Make a prediction based on the bpType
-    switch (bpType)
+    uint8_t loop_pred;
+    if (p->loop != NULL && loop_lookup(p->loop, pc, &loop_pred))
+    {
+        rec->prediction = loop_pred;
+    }
+}
+
+// Train the side components with the outcome of the branch in 'rec',
+// counting their effect when 'count' is set
+//
+static void side_update(predictor_t* p, const bp_lookup_t* rec,
+                        uint8_t outcome, int count)
+{
+    if (count)
+    {
+        bp_side_stats_t* s = &p->side;
+        s->branches++;
+        s->base_mispredictions += rec->base_pred != outcome;
+        if (rec->corrected != rec->base_pred)
+        {
+            s->sc_right += rec->corrected == outcome;
+            s->sc_wrong += rec->corrected != outcome;
+        }
+        if (rec->prediction != rec->corrected)
+        {
+            s->loop_right += rec->prediction == outcome;
+            s->loop_wrong += rec->prediction != outcome;
+        }
+    }
+
+    if (p->sc != NULL)
+    {
+        corrector_update(p->sc, outcome);
+    }
+    if (p->loop != NULL)
+    {
+        loop_update(p->loop, rec->corrected, outcome);
+    }
+}
+
+//------------------------------------//
+//         Simulation Loops           //
+//------------------------------------//
+
+// The loops run a block of branches through one predictor type without
+// dispatching per branch. The gshare and tournament loops take the
+// geometry as arguments and are always inlined, so that the loops of
+// BP_SPECIALIZE, which pass constants, compute every table size and
+// mask at compile time. Tables are reached through local copies of
+// their packed_t with constant widths.
+
+#define ALWAYS_INLINE __attribute__((always_inline)) inline
+
+static ALWAYS_INLINE uint64_t gshare_loop(predictor_t* p, const uint32_t* pc,
+                                          uint64_t taken, int count,
+                                          const int gbits)
+{
+    packed_t bht = {p->bht_gshare.data, 1u << gbits, 2, 3};
+    const uint32_t mask = (1u << gbits) - 1;
+    uint64_t ghistory = p->ghistory;
+    uint64_t mispredictions = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        uint8_t outcome = (taken >> i) & 0x1;
+        uint32_t index = (pc[i] ^ ghistory) & mask;
+        mispredictions += packed_msb(&bht, index) != outcome;
+        packed_count(&bht, index, outcome == TAKEN);
+        ghistory = (ghistory << 1) | outcome;
+    }
+
+    p->ghistory = ghistory;
+    return mispredictions;
+}
+
+// Tournament, or custom when 'custom' is set
+//
+static ALWAYS_INLINE uint64_t trn_loop(predictor_t* p, const uint32_t* pc,
+                                       uint64_t taken, int count,
+                                       const int custom, const int gbits,
+                                       const int lbits, const int pcbits,
+                                       const int cbits)
+{
+    packed_t pht = {p->trn_local_pht.data, 1u << pcbits, lbits,
+                    (1ULL << lbits) - 1};
+    packed_t lbht = {p->trn_local_bht.data, 1u << lbits, 2, 3};
+    packed_t gbht = {p->trn_global_bht.data, 1u << gbits, 2, 3};
+    packed_t chooser = {p->trn_chooser.data, 1u << cbits, 3, 7};
+    uint64_t ghistory = p->ghistory;
+    uint64_t mispredictions = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        uint8_t outcome = (taken >> i) & 0x1;
+        uint32_t index = (custom ? ghistory ^ pc[i] : ghistory) &
+                         ((1u << gbits) - 1);
+        uint32_t choice = ghistory & ((1u << cbits) - 1);
+        uint32_t pc_idx = pc[i] & ((1u << pcbits) - 1);
+        uint32_t pat = packed_get(&pht, pc_idx);
+
+        uint8_t global_pred = packed_msb(&gbht, index);
+        uint8_t local_pred = packed_msb(&lbht, pat);
+        uint8_t prediction =
+            packed_msb(&chooser, choice) ? global_pred : local_pred;
+        mispredictions += prediction != outcome;
+
+        // the updates of update_tournament()
+        if (global_pred != local_pred)
+        {
+            packed_count(&chooser, choice, global_pred == outcome);
+        }
+        ghistory = (ghistory << 1) | outcome;
+        packed_shift(&pht, pc_idx, outcome);
+        packed_count(&gbht, index, outcome == TAKEN);
+        packed_count(&lbht, pat, outcome == TAKEN);
+    }
+
+    p->ghistory = ghistory;
+    return mispredictions;
+}
+
+static uint64_t run_static(predictor_t* p, const uint32_t* pc,
+                           uint64_t taken, int count)
+{
+    (void)p;
+    (void)pc;
+
+    // always taken
+    uint64_t valid = count < 64 ? (1ULL << count) - 1 : ~0ULL;
+    return count - __builtin_popcountll(taken & valid);
+}
+
+static uint64_t run_gshare(predictor_t* p, const uint32_t* pc,
+                           uint64_t taken, int count)
+{
+    return gshare_loop(p, pc, taken, count, p->cfg.ghistoryBits);
+}
+
+static uint64_t run_tournament(predictor_t* p, const uint32_t* pc,
+                               uint64_t taken, int count)
+{
+    return trn_loop(p, pc, taken, count, 0, p->cfg.ghistoryBits,
+                    p->cfg.lhistoryBits, p->cfg.pcIndexBits,
+                    p->cfg.chooserBits);
+}
+
+static uint64_t run_custom(predictor_t* p, const uint32_t* pc,
+                           uint64_t taken, int count)
+{
+    return trn_loop(p, pc, taken, count, 1, p->cfg.ghistoryBits,
+                    p->cfg.lhistoryBits, p->cfg.pcIndexBits,
+                    p->cfg.chooserBits);
+}
+
+static uint64_t run_tage(predictor_t* p, const uint32_t* pc,
+                         uint64_t taken, int count)
+{
+    uint64_t mispredictions = 0;
+    for (int i = 0; i < count; i++)
+    {
+        bp_lookup_t rec;
+        uint8_t outcome = (taken >> i) & 0x1;
+        mispredictions += tage_lookup(p->tage, pc[i], &rec) != outcome;
+        tage_update(p->tage, &rec, outcome);
+    }
+    return mispredictions;
+}
+
+static uint64_t run_perceptron(predictor_t* p, const uint32_t* pc,
+                               uint64_t taken, int count)
+{
+    uint64_t mispredictions = 0;
+    for (int i = 0; i < count; i++)
+    {
+        bp_lookup_t rec;
+        uint8_t outcome = (taken >> i) & 0x1;
+        mispredictions +=
+            perceptron_lookup(p->perceptron, pc[i], &rec) != outcome;
+        perceptron_update(p->perceptron, &rec, outcome);
+    }
+    return mispredictions;
+}
+
+// Any type with side components, through the lookup and update
+//
+static uint64_t run_side(predictor_t* p, const uint32_t* pc,
+                         uint64_t taken, int count)
+{
+    uint64_t mispredictions = 0;
+    for (int i = 0; i < count; i++)
+    {
+        bp_lookup_t rec;
+        uint8_t outcome = (taken >> i) & 0x1;
+        mispredictions += predictor_lookup(p, pc[i], &rec) != outcome;
+        predictor_update(p, &rec, outcome);
+    }
+    return mispredictions;
+}
+
+#ifdef BP_SPECIALIZE
+
+// Geometries with specialized loops: the defaults and the usual sweep
+// ranges. Each X(...) entry becomes one loop.
+#define SPECIALIZED_GSHARE(X)                                              \
+    X(8) X(9) X(10) X(11) X(12) X(13) X(14) X(15) X(16) X(17) X(18)
+#define SPECIALIZED_TOURNAMENT(X)                                          \
+    X(10, 10, 10, 9) X(11, 10, 11, 10) X(12, 10, 11, 11)                   \
+    X(13, 10, 11, 12) X(13, 11, 12, 12)
+
+#define GSHARE_RUN(g)                                                      \
+    static uint64_t run_gshare_##g(predictor_t* p, const uint32_t* pc,     \
+                                   uint64_t taken, int count)              \
+    {                                                                      \
+        return gshare_loop(p, pc, taken, count, g);                        \
+    }
+#define TOURNAMENT_RUN(g, l, i, c)                                         \
+    static uint64_t run_tournament_##g##_##l##_##i##_##c(                  \
+        predictor_t* p, const uint32_t* pc, uint64_t taken, int count)     \
+    {                                                                      \
+        return trn_loop(p, pc, taken, count, 0, g, l, i, c);               \
+    }                                                                      \
+    static uint64_t run_custom_##g##_##l##_##i##_##c(                      \
+        predictor_t* p, const uint32_t* pc, uint64_t taken, int count)     \
+    {                                                                      \
+        return trn_loop(p, pc, taken, count, 1, g, l, i, c);               \
+    }
+
+SPECIALIZED_GSHARE(GSHARE_RUN)
+SPECIALIZED_TOURNAMENT(TOURNAMENT_RUN)
+
+typedef struct
+{
+    int bpType;
+    int ghistoryBits;
+    int lhistoryBits;
+    int pcIndexBits;
+    int chooserBits;
+    bp_run_t run;
+} specialized_t;
+
+#define GSHARE_ENTRY(g) {GSHARE, g, 0, 0, 0, run_gshare_##g},
+#define TOURNAMENT_ENTRY(g, l, i, c)                                       \
+    {TOURNAMENT, g, l, i, c, run_tournament_##g##_##l##_##i##_##c},        \
+        {CUSTOM, g, l, i, c, run_custom_##g##_##l##_##i##_##c},
+
+static const specialized_t specialized[] = {
+    SPECIALIZED_GSHARE(GSHARE_ENTRY)
+    SPECIALIZED_TOURNAMENT(TOURNAMENT_ENTRY)};
+
+#endif
+
+// Pick the simulation loop of 'cfg', specialized for its geometry when
+// there is one
+//
+static bp_run_t select_run(const bp_config_t* cfg)
+{
+    if (has_side(cfg))
+    {
+        return run_side;
+    }
+
+#ifdef BP_SPECIALIZE
+    for (size_t i = 0; i < sizeof(specialized) / sizeof(specialized[0]); i++)
+    {
+        const specialized_t* s = &specialized[i];
+        if (s->bpType == cfg->bpType && s->ghistoryBits == cfg->ghistoryBits &&
+            (cfg->bpType == GSHARE ||
+             (s->lhistoryBits == cfg->lhistoryBits &&
+              s->pcIndexBits == cfg->pcIndexBits &&
+              s->chooserBits == cfg->chooserBits)))
+        {
+            return s->run;
+        }
+    }
+#endif
+
+    switch (cfg->bpType)
     {
-    case STATIC:
-        return TAKEN;
     case GSHARE:
-        return gshare_predict(pc);
+        return run_gshare;
     case TOURNAMENT:
-        return tournament_predict(pc);
+        return run_tournament;
     case CUSTOM:
-        return custom_predict(pc);
+        return run_custom;
+    case TAGE:
+        return run_tage;
+    case PERCEPTRON:
+        return run_perceptron;
     default:
-        break;
+        return run_static;
     }
+}
 
-    // If there is not a compatable bpType then return NOTTAKEN
-    return NOTTAKEN;
+//------------------------------------//
+//        Predictor Instances         //
+//------------------------------------//
+
+void predictor_default_config(bp_config_t* cfg, int type)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->bpType = type;
+    switch (type)
+    {
+    case GSHARE:
+        cfg->ghistoryBits = 14;
+        cfg->lhistoryBits = 0;
+        cfg->pcIndexBits = 0;
+        cfg->chooserBits = 0;
+        break;
+    case TOURNAMENT:
+    case CUSTOM:
+        cfg->ghistoryBits = 12;
+        cfg->lhistoryBits = 10;
+        cfg->pcIndexBits = 11;
+        cfg->chooserBits = 11;
+        break;
+    case TAGE:
+        // the most accurate geometry found within the budget
+        cfg->ghistoryBits = 0;
+        cfg->lhistoryBits = 0;
+        cfg->pcIndexBits = 9;
+        cfg->chooserBits = 0;
+        cfg->numTables = 4;
+        cfg->minHistory = 5;
+        cfg->maxHistory = 79;
+        cfg->tagBits = 9;
+        break;
+    case PERCEPTRON:
+        cfg->ghistoryBits = 60;
+        cfg->numRows = 64;
+        break;
+    default:
+        cfg->ghistoryBits = 0;
+        cfg->lhistoryBits = 0;
+        cfg->pcIndexBits = 0;
+        cfg->chooserBits = 0;
+        break;
+    }
 }
 
-// Train the predictor the last executed branch at PC 'pc' and with
-// outcome 'outcome' (true indicates that the branch was taken, false
-// indicates that the branch was not taken)
+// Table indices must fit the 32 bit PC, local histories the PHT entries
 //
-
-void train_predictor(uint32_t pc, uint8_t outcome)
+// Returns True if the geometry is valid
+//
+static int valid_config(const bp_config_t* cfg)
 {
+    if ((cfg->loopBits != 0 && (cfg->loopBits < LOOP_MIN_BITS ||
+                                cfg->loopBits > LOOP_MAX_BITS)) ||
+        (cfg->scBits != 0 &&
+         (cfg->scBits < SC_MIN_BITS || cfg->scBits > SC_MAX_BITS)))
+    {
+        return 0;
+    }
+    if (cfg->bpType == TAGE)
+    {
+        return tage_valid_config(cfg);
+    }
+    if (cfg->bpType == PERCEPTRON)
+    {
+        return perceptron_valid_config(cfg);
+    }
+    return cfg->bpType >= STATIC && cfg->bpType < NUM_TYPES &&
+           cfg->ghistoryBits >= 0 && cfg->ghistoryBits <= 30 &&
+           cfg->pcIndexBits >= 0 && cfg->pcIndexBits <= 30 &&
+           cfg->chooserBits >= 0 && cfg->chooserBits <= 30 &&
+           cfg->lhistoryBits >= 0 && cfg->lhistoryBits <= 16;
+}
 
-    switch (bpType)
+int predictor_set_params(bp_config_t* cfg, const int* params, int count)
+{
+    switch (cfg->bpType)
     {
     case STATIC:
+        if (count > 0)
+            return 0;
         break;
     case GSHARE:
-        return train_gshare(pc, outcome);
+        if (count > 1)
+            return 0;
+        if (count > 0)
+            cfg->ghistoryBits = params[0];
+        break;
     case TOURNAMENT:
-        return train_tournament(pc, outcome);
     case CUSTOM:
-        return train_custom(pc, outcome);
-    default:
+        if (count > 4)
+            return 0;
+        if (count > 0)
+        {
+            // the chooser follows the global history unless given
+            cfg->ghistoryBits = params[0];
+            cfg->chooserBits = MAX(params[0] - 1, 0);
+        }
+        if (count > 1)
+            cfg->lhistoryBits = params[1];
+        if (count > 2)
+            cfg->pcIndexBits = params[2];
+        if (count > 3)
+            cfg->chooserBits = params[3];
+        break;
+    case TAGE:
+        if (count > 5)
+            return 0;
+        if (count > 0)
+            cfg->numTables = params[0];
+        if (count > 1)
+            cfg->minHistory = params[1];
+        if (count > 2)
+            cfg->maxHistory = params[2];
+        if (count > 3)
+            cfg->pcIndexBits = params[3];
+        if (count > 4)
+            cfg->tagBits = params[4];
         break;
+    case PERCEPTRON:
+        if (count > 2)
+            return 0;
+        if (count > 0)
+            cfg->ghistoryBits = params[0];
+        if (count > 1)
+            cfg->numRows = params[1];
+        break;
+    default:
+        return 0;
+    }
+
+    return valid_config(cfg);
+}
+
+int predictor_parse_type(const char* name, size_t len)
+{
+    for (int i = STATIC; i < NUM_TYPES; i++)
+    {
+        if (strlen(bpName[i]) == len && !strncasecmp(name, bpName[i], len))
+        {
+            return i;
+        }
     }
+    return -1;
+}
+
+// Parse the side components "+loop[:<# bits>]" and "+sc[:<# bits>]"
+// ending a spec, from 'side' on, into 'cfg'
+//
+// Returns True if Successful
+//
+static int parse_side(const char* side, bp_config_t* cfg)
+{
+    while (side != NULL && *side == '+')
+    {
+        const char* name = side + 1;
+        size_t len = strcspn(name, ":+");
+        int* bits;
+        if (len == 4 && !strncasecmp(name, "loop", len))
+        {
+            bits = &cfg->loopBits;
+            *bits = LOOP_DEFAULT_BITS;
+        }
+        else if (len == 2 && !strncasecmp(name, "sc", len))
+        {
+            bits = &cfg->scBits;
+            *bits = SC_DEFAULT_BITS;
+        }
+        else
+        {
+            return 0;
+        }
+
+        side = name + len;
+        if (*side == ':')
+        {
+            char* end;
+            *bits = (int)strtol(side + 1, &end, 10);
+            if (end == side + 1)
+            {
+                return 0;
+            }
+            side = end;
+        }
+    }
+    return (side == NULL || *side == '\0') && valid_config(cfg);
+}
+
+int predictor_parse_config(const char* spec, bp_config_t* cfg)
+{
+    size_t len = strcspn(spec, ":+");
+    const char* sep = spec[len] == ':' ? spec + len : NULL;
+    int type = predictor_parse_type(spec, len);
+    if (type < 0)
+    {
+        return 0;
+    }
+    predictor_default_config(cfg, type);
+
+    int params[BP_MAX_PARAMS];
+    int count = 0;
+    while (sep != NULL)
+    {
+        char* end;
+        long val = strtol(sep + 1, &end, 10);
+        if (end == sep + 1 ||
+            (*end != ':' && *end != '+' && *end != '\0') ||
+            count == BP_MAX_PARAMS)
+        {
+            return 0;
+        }
+        params[count++] = (int)val;
+        sep = *end == ':' ? end : NULL;
+    }
+
+    return predictor_set_params(cfg, params, count) &&
+           parse_side(strchr(spec, '+'), cfg);
+}
+
+void predictor_config_name(const bp_config_t* cfg, char* buf, size_t len)
+{
+    switch (cfg->bpType)
+    {
+    case GSHARE:
+        snprintf(buf, len, "gshare:%d", cfg->ghistoryBits);
+        break;
+    case TOURNAMENT:
+    case CUSTOM:
+        snprintf(buf, len, "%s:%d:%d:%d:%d",
+                 cfg->bpType == TOURNAMENT ? "tournament" : "custom",
+                 cfg->ghistoryBits, cfg->lhistoryBits, cfg->pcIndexBits,
+                 cfg->chooserBits);
+        break;
+    case TAGE:
+        snprintf(buf, len, "tage:%d:%d:%d:%d:%d", cfg->numTables,
+                 cfg->minHistory, cfg->maxHistory, cfg->pcIndexBits,
+                 cfg->tagBits);
+        break;
+    case PERCEPTRON:
+        snprintf(buf, len, "perceptron:%d:%d", cfg->ghistoryBits,
+                 cfg->numRows);
+        break;
+    default:
+        snprintf(buf, len, "static");
+        break;
+    }
+
+    size_t n = strlen(buf);
+    if (cfg->loopBits > 0 && n < len)
+    {
+        n += snprintf(buf + n, len - n, "+loop:%d", cfg->loopBits);
+    }
+    if (cfg->scBits > 0 && n < len)
+    {
+        snprintf(buf + n, len - n, "+sc:%d", cfg->scBits);
+    }
+}
+
+int predictor_name_width(const bp_config_t* cfgs, int num_cfgs)
+{
+    int width = 24;
+    for (int i = 0; i < num_cfgs; i++)
+    {
+        char name[64];
+        predictor_config_name(&cfgs[i], name, sizeof(name));
+        int n = (int)strlen(name);
+        width = n > width ? n : width;
+    }
+    return width;
+}
+
+static void add_component(bp_budget_t* budget, const char* name,
+                          uint64_t entries, uint32_t bits, int reg)
+{
+    bp_component_t* c = &budget->comp[budget->count++];
+    c->name = name;
+    c->entries = entries;
+    c->bits = bits;
+    c->reg = reg;
+    if (reg)
+        budget->reg_bits += entries * bits;
+    else
+        budget->table_bits += entries * bits;
+}
+
+void predictor_budget(const bp_config_t* cfg, bp_budget_t* budget)
+{
+    uint32_t g = cfg->ghistoryBits, l = cfg->lhistoryBits;
+    uint32_t i = cfg->pcIndexBits, c = cfg->chooserBits;
+
+    memset(budget, 0, sizeof(*budget));
+    switch (cfg->bpType)
+    {
+    case GSHARE:
+        add_component(budget, "bht", 1ULL << g, 2, 0);
+        add_component(budget, "ghistory", 1, g, 1);
+        break;
+    case TOURNAMENT:
+    case CUSTOM:
+        add_component(budget, "local pht", 1ULL << i, l, 0);
+        add_component(budget, "local bht", 1ULL << l, trn_local_bhtBits, 0);
+        add_component(budget, "global bht", 1ULL << g, trn_global_bhtBits,
+                      0);
+        add_component(budget, "chooser", 1ULL << c, trn_chooserBits, 0);
+        // long enough for both global indices
+        add_component(budget, "ghistory", 1, MAX(g, c), 1);
+        break;
+    case TAGE:
+    {
+        uint64_t n = (uint64_t)cfg->numTables << i;
+        uint32_t t = cfg->tagBits;
+        add_component(budget, "base bht", 4ULL << i, 2, 0);
+        add_component(budget, "tagged ctr", n, TAGE_CTR_BITS, 0);
+        add_component(budget, "tagged tag", n, t, 0);
+        add_component(budget, "tagged u", n, TAGE_U_BITS, 0);
+        add_component(budget, "ghistory", 1, cfg->maxHistory, 1);
+        // one index and two tag folds per table
+        add_component(budget, "folded", cfg->numTables, i + 2 * t - 1, 1);
+        add_component(budget, "use alt", 1, TAGE_USE_ALT_BITS, 1);
+        add_component(budget, "alloc seed", 1, TAGE_SEED_BITS, 1);
+        add_component(budget, "u tick", 1, TAGE_U_TICK_BITS, 1);
+        // indices and tags held from the lookup to the update
+        add_component(budget, "base index", 1, i + 2, 1);
+        add_component(budget, "last lookup", cfg->numTables, i + t, 1);
+        break;
+    }
+    case PERCEPTRON:
+        // a bias weight per row on top of the history weights
+        add_component(budget, "weights", (uint64_t)cfg->numRows * (g + 1),
+                      PERCEPTRON_WEIGHT_BITS, 0);
+        add_component(budget, "ghistory", 1, g, 1);
+        break;
+    default:
+        break;
+    }
+
+    if (cfg->loopBits > 0)
+    {
+        add_component(budget, "loop table", 1ULL << cfg->loopBits,
+                      LOOP_ENTRY_BITS, 0);
+        add_component(budget, "loop use", 1, LOOP_USE_BITS, 1);
+    }
+    if (cfg->scBits > 0)
+    {
+        add_component(budget, "sc tables", (uint64_t)SC_NUM_TABLES
+                                               << cfg->scBits,
+                      SC_CTR_BITS, 0);
+        add_component(budget, "sc history", 1, SC_HISTORY_BITS, 1);
+        add_component(budget, "sc threshold", 1,
+                      SC_THRESHOLD_BITS + SC_TC_BITS, 1);
+    }
+}
+
+int predictor_fits_budget(const bp_budget_t* budget)
+{
+    return budget->table_bits <= BP_BUDGET_TABLE_BITS &&
+           budget->reg_bits <= BP_BUDGET_REG_BITS;
+}
+
+uint64_t predictor_storage_bits(const bp_config_t* cfg)
+{
+    bp_budget_t budget;
+    predictor_budget(cfg, &budget);
+    return budget.table_bits + budget.reg_bits;
+}
+
+void predictor_side_bits(const bp_config_t* cfg, uint64_t* loop,
+                         uint64_t* sc)
+{
+    bp_config_t base = *cfg;
+    base.loopBits = 0;
+    base.scBits = 0;
+    bp_config_t with_loop = base;
+    with_loop.loopBits = cfg->loopBits;
+
+    uint64_t bits = predictor_storage_bits(&base);
+    *loop = predictor_storage_bits(&with_loop) - bits;
+    *sc = predictor_storage_bits(cfg) - bits - *loop;
+}
+
+predictor_t* predictor_create(const bp_config_t* cfg)
+{
+    if (!valid_config(cfg))
+    {
+        return NULL;
+    }
+
+    predictor_t* p = (predictor_t*)calloc(1, sizeof(predictor_t));
+    p->cfg = *cfg;
+
+    switch (p->cfg.bpType)
+    {
+    case STATIC:
+        break;
+    case GSHARE:
+        init_gshare(p);
+        break;
+    case TOURNAMENT:
+        init_tournament(p);
+        break;
+    case CUSTOM:
+        init_custom(p);
+        break;
+    case TAGE:
+        p->tage = tage_create(cfg);
+        break;
+    case PERCEPTRON:
+        p->perceptron = perceptron_create(cfg);
+        break;
+    default:
+        break;
+    }
+    if (cfg->loopBits > 0)
+    {
+        p->loop = loop_create(cfg->loopBits);
+    }
+    if (cfg->scBits > 0)
+    {
+        p->sc = corrector_create(cfg->scBits);
+    }
+    p->run = select_run(&p->cfg);
+
+    return p;
+}
+
+const bp_config_t* predictor_config(const predictor_t* p)
+{
+    return &p->cfg;
+}
+
+void predictor_reset(predictor_t* p)
+{
+    switch (p->cfg.bpType)
+    {
+    case GSHARE:
+        reset_gshare(p);
+        break;
+    case TOURNAMENT:
+        reset_tournament(p);
+        break;
+    case CUSTOM:
+        reset_custom(p);
+        break;
+    case TAGE:
+        tage_reset(p->tage);
+        break;
+    case PERCEPTRON:
+        perceptron_reset(p->perceptron);
+        break;
+    default:
+        break;
+    }
+    if (p->loop != NULL)
+    {
+        loop_reset(p->loop);
+    }
+    if (p->sc != NULL)
+    {
+        corrector_reset(p->sc);
+    }
+    memset(&p->side, 0, sizeof(p->side));
+}
+
+uint8_t predictor_predict(predictor_t* p, uint32_t pc)
+{
+    if (has_side(&p->cfg))
+    {
+        bp_lookup_t rec;
+        return predictor_lookup(p, pc, &rec);
+    }
+
+    // Make a prediction based on the bpType
+    switch (p->cfg.bpType)
+    {
+    case STATIC:
+        return TAKEN;
+    case GSHARE:
+        return gshare_predict(p, pc);
+    case TOURNAMENT:
+        return tournament_predict(p, pc);
+    case CUSTOM:
+        return custom_predict(p, pc);
+    case TAGE:
+    {
+        bp_lookup_t rec;
+        return tage_lookup(p->tage, pc, &rec);
+    }
+    case PERCEPTRON:
+    {
+        bp_lookup_t rec;
+        return perceptron_lookup(p->perceptron, pc, &rec);
+    }
+    default:
+        break;
+    }
+
+    // If there is not a compatable bpType then return NOTTAKEN
+    return NOTTAKEN;
+}
+
+// Train the base predictor and the side components of 'p' with the
+// outcome of the branch in 'rec', counting the branch when 'count' is set
+//
+static void side_train(predictor_t* p, const bp_lookup_t* rec,
+                       uint8_t outcome, int count);
+
+void predictor_train(predictor_t* p, uint32_t pc, uint8_t outcome)
+{
+    if (has_side(&p->cfg))
+    {
+        bp_lookup_t rec;
+        predictor_lookup(p, pc, &rec);
+        return side_train(p, &rec, outcome, 0);
+    }
+
+    switch (p->cfg.bpType)
+    {
+    case STATIC:
+        break;
+    case GSHARE:
+        return train_gshare(p, pc, outcome);
+    case TOURNAMENT:
+        return train_tournament(p, pc, outcome);
+    case CUSTOM:
+        return train_custom(p, pc, outcome);
+    case TAGE:
+    {
+        // the lookup only recomputes the indices, so repeat it here
+        bp_lookup_t rec;
+        tage_lookup(p->tage, pc, &rec);
+        return tage_update(p->tage, &rec, outcome);
+    }
+    case PERCEPTRON:
+    {
+        bp_lookup_t rec;
+        perceptron_lookup(p->perceptron, pc, &rec);
+        return perceptron_update(p->perceptron, &rec, outcome);
+    }
+    default:
+        break;
+    }
+}
+
+static uint8_t base_lookup(predictor_t* p, uint32_t pc, bp_lookup_t* rec)
+{
+    switch (p->cfg.bpType)
+    {
+    case STATIC:
+        rec->prediction = TAKEN;
+        return TAKEN;
+    case GSHARE:
+        return gshare_lookup(p, pc, rec);
+    case TOURNAMENT:
+        return tournament_lookup(p, pc, rec);
+    case CUSTOM:
+        return custom_lookup(p, pc, rec);
+    case TAGE:
+        return tage_lookup(p->tage, pc, rec);
+    case PERCEPTRON:
+        return perceptron_lookup(p->perceptron, pc, rec);
+    default:
+        break;
+    }
+
+    rec->prediction = NOTTAKEN;
+    return NOTTAKEN;
+}
+
+uint8_t predictor_lookup(predictor_t* p, uint32_t pc, bp_lookup_t* rec)
+{
+    base_lookup(p, pc, rec);
+    rec->base_pred = rec->prediction;
+    if (has_side(&p->cfg))
+    {
+        side_lookup(p, pc, rec);
+    }
+    return rec->prediction;
+}
+
+static void base_update(predictor_t* p, const bp_lookup_t* rec,
+                        uint8_t outcome)
+{
+    switch (p->cfg.bpType)
+    {
+    case GSHARE:
+        return update_gshare(p, rec, outcome);
+    case TOURNAMENT:
+    case CUSTOM:
+        return update_tournament(p, rec, outcome);
+    case TAGE:
+        return tage_update(p->tage, rec, outcome);
+    case PERCEPTRON:
+        return perceptron_update(p->perceptron, rec, outcome);
+    default:
+        break;
+    }
+}
+
+static void side_train(predictor_t* p, const bp_lookup_t* rec,
+                       uint8_t outcome, int count)
+{
+    // the base trains on its own prediction
+    bp_lookup_t base = *rec;
+    base.prediction = rec->base_pred;
+    base_update(p, &base, outcome);
+    side_update(p, rec, outcome, count);
+}
+
+void predictor_update(predictor_t* p, const bp_lookup_t* rec,
+                      uint8_t outcome)
+{
+    if (has_side(&p->cfg))
+    {
+        return side_train(p, rec, outcome, 1);
+    }
+    base_update(p, rec, outcome);
+}
+
+uint8_t predictor_predict_and_update(predictor_t* p, uint32_t pc,
+                                     uint8_t outcome)
+{
+    bp_lookup_t rec;
+
+    if (has_side(&p->cfg))
+    {
+        predictor_lookup(p, pc, &rec);
+        side_train(p, &rec, outcome, 1);
+        return rec.prediction;
+    }
+
+    switch (p->cfg.bpType)
+    {
+    case STATIC:
+        return TAKEN;
+    case GSHARE:
+        gshare_lookup(p, pc, &rec);
+        update_gshare(p, &rec, outcome);
+        return rec.prediction;
+    case TOURNAMENT:
+        tournament_lookup(p, pc, &rec);
+        update_tournament(p, &rec, outcome);
+        return rec.prediction;
+    case CUSTOM:
+        custom_lookup(p, pc, &rec);
+        update_tournament(p, &rec, outcome);
+        return rec.prediction;
+    case TAGE:
+        tage_lookup(p->tage, pc, &rec);
+        tage_update(p->tage, &rec, outcome);
+        return rec.prediction;
+    case PERCEPTRON:
+        perceptron_lookup(p->perceptron, pc, &rec);
+        perceptron_update(p->perceptron, &rec, outcome);
+        return rec.prediction;
+    default:
+        break;
+    }
+
+    return NOTTAKEN;
+}
+
+uint64_t predictor_run(predictor_t* p, const uint32_t* pc, uint64_t taken,
+                       int count)
+{
+    return p->run(p, pc, taken, count);
+}
+
+void predictor_state(predictor_t* p, bp_state_t* s)
+{
+    switch (p->cfg.bpType)
+    {
+    case GSHARE:
+        state_packed(s, &p->bht_gshare);
+        state_bytes(s, &p->ghistory, sizeof(p->ghistory));
+        break;
+    case TOURNAMENT:
+    case CUSTOM:
+        state_packed(s, &p->trn_local_pht);
+        state_packed(s, &p->trn_local_bht);
+        state_packed(s, &p->trn_global_bht);
+        state_packed(s, &p->trn_chooser);
+        state_bytes(s, &p->ghistory, sizeof(p->ghistory));
+        break;
+    case TAGE:
+        tage_state(p->tage, s);
+        break;
+    case PERCEPTRON:
+        perceptron_state(p->perceptron, s);
+        break;
+    default:
+        break;
+    }
+    if (p->loop != NULL)
+    {
+        loop_state(p->loop, s);
+    }
+    if (p->sc != NULL)
+    {
+        corrector_state(p->sc, s);
+    }
+}
+
+void predictor_side_stats(const predictor_t* p, bp_side_stats_t* stats)
+{
+    *stats = p->side;
+}
+
+void predictor_destroy(predictor_t* p)
+{
+    switch (p->cfg.bpType)
+    {
+    case GSHARE:
+        cleanup_gshare(p);
+        break;
+    case TOURNAMENT:
+        cleanup_tournament(p);
+        break;
+    case CUSTOM:
+        cleanup_custom(p);
+        break;
+    case TAGE:
+        tage_destroy(p->tage);
+        break;
+    case PERCEPTRON:
+        perceptron_destroy(p->perceptron);
+        break;
+    default:
+        break;
+    }
+    if (p->loop != NULL)
+    {
+        loop_destroy(p->loop);
+    }
+    if (p->sc != NULL)
+    {
+        corrector_destroy(p->sc);
+    }
+    free(p);
+}
+
+//------------------------------------//
+//     Single Predictor Interface     //
+//------------------------------------//
+
+void init_predictor()
+{
+    bp_config_t cfg;
+    predictor_default_config(&cfg, bpType);
+    if (bpType == GSHARE)
+    {
+        cfg.ghistoryBits = ghistoryBits;
+    }
+    else if (bpType == TOURNAMENT || bpType == CUSTOM)
+    {
+        cfg.lhistoryBits = lhistoryBits;
+        cfg.pcIndexBits = pcIndexBits;
+    }
+    default_predictor = predictor_create(&cfg);
+}
+
+// Make a prediction for conditional branch instruction at PC 'pc'
+// Returning TAKEN indicates a prediction of taken; returning NOTTAKEN
+// indicates a prediction of not taken
+//
+uint8_t make_prediction(uint32_t pc)
+{
+    return predictor_predict(default_predictor, pc);
+}
+
+// Train the predictor the last executed branch at PC 'pc' and with
+// outcome 'outcome' (true indicates that the branch was taken, false
+// indicates that the branch was not taken)
+//
+
+void train_predictor(uint32_t pc, uint8_t outcome)
+{
+    predictor_train(default_predictor, pc, outcome);
 }
@@ -30,6 +30,9 @@ extern const char* email;
 #define GSHARE     1
 #define TOURNAMENT 2
 #define CUSTOM     3
+#define TAGE       4
+#define PERCEPTRON 5
+#define NUM_TYPES  6
 extern const char* bpName[];
 
 // Definitions for 2-bit counters
@@ -47,10 +50,243 @@ extern int pcIndexBits;  // Number of bits used for PC index
 extern int bpType;       // Branch Prediction Type
 extern int verbose;
 
+//------------------------------------//
+//       Reentrant Predictor API      //
+//------------------------------------//
+
+// Geometry of a predictor, fixed when an instance is created
+//
+//   gshare:             ghistoryBits of history xor'ed with the PC index
+//                       a table of 2^ghistoryBits counters
+//   tournament, custom: ghistoryBits index the global BHT, chooserBits
+//                       the chooser, pcIndexBits the local history table
+//                       which holds lhistoryBits of history per entry
+//   tage:               numTables tagged tables of 2^pcIndexBits entries
+//                       with tagBits tags, using histories growing
+//                       geometrically from minHistory to maxHistory bits,
+//                       over a base table of 2^(pcIndexBits + 2) counters
+//   perceptron:         numRows rows of weights for ghistoryBits of
+//                       history, a row picked by the PC
+//
+// Any type may be wrapped in side components: a loop predictor of
+// 2^loopBits entries and a statistical corrector with tables of 2^scBits
+// counters, each left out when its size is 0.
+//
+typedef struct
+{
+    int bpType;       // Branch Prediction Type
+    int ghistoryBits; // Number of bits used for Global History
+    int lhistoryBits; // Number of bits used for Local History
+    int pcIndexBits;  // Number of bits used for PC index
+    int chooserBits;  // Number of bits used for the chooser index
+    int numTables;    // Number of TAGE tagged tables
+    int minHistory;   // Shortest TAGE history
+    int maxHistory;   // Longest TAGE history
+    int tagBits;      // Number of bits in a TAGE tag
+    int numRows;      // Number of perceptron weight rows
+    int loopBits;     // Log2 of the loop predictor entries, 0 for none
+    int scBits;       // Log2 of the corrector table entries, 0 for none
+} bp_config_t;
+
+// A predictor instance. Instances share no state, so any number of them
+// can be used at once, including from different threads as long as each
+// instance is only used by one thread at a time.
+typedef struct predictor predictor_t;
+
+// Fill 'cfg' with the default geometry of predictor type 'type'
+//
+void predictor_default_config(bp_config_t* cfg, int type);
+
+// Most parameters any predictor type takes
+#define BP_MAX_PARAMS 5
+
+// Parse a predictor type name of length 'len' (case insensitive)
+//
+// Returns the type, or -1 if unknown
+//
+int predictor_parse_type(const char* name, size_t len);
+
+// Set the geometry of 'cfg' from the 'count' parameters of its type, in
+// the order of the command line syntax:
+//
+//   gshare:<# ghistory>
+//   tournament:<# ghistory>:<# lhistory>:<# index>[:<# chooser>]
+//   custom:<# ghistory>:<# lhistory>:<# index>[:<# chooser>]
+//   tage:<# tables>:<# min history>:<# max history>:<# index>:<# tag>
+//   perceptron:<# history>:<# rows>
+//
+// The chooser index defaults to one bit less than the global history.
+//
+// Returns True if the resulting geometry is valid
+//
+int predictor_set_params(bp_config_t* cfg, const int* params, int count);
+
+// Parse a predictor spec such as "gshare:13" into 'cfg', using the
+// default geometry for any parameters left out. The spec may end with
+// side components, "+loop[:<# loop bits>]" and "+sc[:<# sc bits>]".
+//
+// Returns True if Successful
+//
+int predictor_parse_config(const char* spec, bp_config_t* cfg);
+
+// Write the spec of 'cfg' with all of its parameters into 'buf'
+//
+void predictor_config_name(const bp_config_t* cfg, char* buf, size_t len);
+
+// Get the width of a table column holding the specs of 'num_cfgs'
+// predictors, the longest of them but no less than 24
+//
+int predictor_name_width(const bp_config_t* cfgs, int num_cfgs);
+
+// Hardware budget of the lab: 32Kb of tables plus 320 bits for
+// registers and such
+#define BP_BUDGET_TABLE_BITS 32768
+#define BP_BUDGET_REG_BITS   320
+
+#define BP_MAX_COMPONENTS 16
+
+// One table or register of a predictor, as it is stored
+typedef struct
+{
+    const char* name;
+    uint64_t entries;
+    uint32_t bits; // per entry
+    int reg;       // a register rather than a table
+} bp_component_t;
+
+typedef struct
+{
+    int count;
+    bp_component_t comp[BP_MAX_COMPONENTS];
+    uint64_t table_bits;
+    uint64_t reg_bits;
+} bp_budget_t;
+
+// Break the state the geometry in 'cfg' requires down into its tables
+// and registers
+//
+void predictor_budget(const bp_config_t* cfg, bp_budget_t* budget);
+
+// Returns True if the state fits the hardware budget of the lab
+//
+int predictor_fits_budget(const bp_budget_t* budget);
+
+// Get the number of bits of state (tables and history registers) the
+// geometry in 'cfg' requires
+//
+uint64_t predictor_storage_bits(const bp_config_t* cfg);
+
+// Get the bits of state of the side components of 'cfg', the loop
+// predictor in 'loop' and the statistical corrector in 'sc'
+//
+void predictor_side_bits(const bp_config_t* cfg, uint64_t* loop,
+                         uint64_t* sc);
+
+// Create a predictor with the geometry in 'cfg'
+//
+// Returns NULL if the geometry is invalid
+//
+predictor_t* predictor_create(const bp_config_t* cfg);
+
+// Get the geometry predictor 'p' was created with
+//
+const bp_config_t* predictor_config(const predictor_t* p);
+
+// Return predictor 'p' to its initial state
+//
+void predictor_reset(predictor_t* p);
+
+// Make a prediction with predictor 'p' for the branch at PC 'pc'
+//
+uint8_t predictor_predict(predictor_t* p, uint32_t pc);
+
+// Train predictor 'p' with the outcome of the branch at PC 'pc'
+//
+void predictor_train(predictor_t* p, uint32_t pc, uint8_t outcome);
+
+// Everything a prediction looked up: the table indices it used and the
+// component predictions it read. Carrying this record from the lookup to
+// the update saves recomputing the indices and rereading the tables.
+typedef struct
+{
+    uint8_t prediction;    // final prediction
+    uint8_t global_pred;   // tournament/custom global component
+    uint8_t local_pred;    // tournament/custom local component
+    uint32_t index;        // gshare BHT, tournament/custom global BHT,
+                           // tage provider entry or perceptron row
+    uint32_t chooser;      // chooser entry
+    uint32_t pc_idx;       // local history table entry
+    uint32_t pat;          // local BHT entry (the local history)
+    int provider;          // tage table of the prediction, 0 the base
+    int alt;               // tage table of the alternate, 0 the base
+    uint8_t provider_pred; // tage provider prediction
+    uint8_t alt_pred;      // tage alternate prediction
+    int32_t output;        // perceptron output
+    uint8_t base_pred;     // prediction of the base predictor
+    uint8_t corrected;     // prediction after the corrector, before the
+                           // loop predictor
+} bp_lookup_t;
+
+// Make a prediction with predictor 'p' for the branch at PC 'pc', filling
+// 'rec' for the matching predictor_update(). The update must happen
+// before the next lookup on the same predictor.
+//
+uint8_t predictor_lookup(predictor_t* p, uint32_t pc, bp_lookup_t* rec);
+
+// Train predictor 'p' with the outcome of the branch looked up in 'rec'
+//
+void predictor_update(predictor_t* p, const bp_lookup_t* rec,
+                      uint8_t outcome);
+
+// Predict the branch at PC 'pc' and train with its known 'outcome' in one
+// step, for trace driven simulation. Same result as predictor_predict()
+// followed by predictor_train().
+//
+// Returns the prediction made before training
+//
+uint8_t predictor_predict_and_update(predictor_t* p, uint32_t pc,
+                                     uint8_t outcome);
+
+// Predict and train 'p' on 'count' branches, at most 64, with the PCs in
+// 'pc' and the outcomes in the bits of 'taken', as in a trace block. The
+// loop is chosen once when the predictor is created; built with
+// BP_SPECIALIZE (make SPECIALIZE=1), common geometries get loops with
+// their table sizes compiled in. Same result as predictor_predict_and_
+// update() on each branch.
+//
+// Returns the number of mispredictions
+//
+uint64_t predictor_run(predictor_t* p, const uint32_t* pc, uint64_t taken,
+                       int count);
+
+// Effect of the side components of a predictor since it was created or
+// reset: the mispredictions its base predictor made, and the predictions
+// the corrector and the loop predictor changed, rightly or wrongly.
+// Branches only trained with predictor_train() are not counted.
+typedef struct
+{
+    uint64_t branches;
+    uint64_t base_mispredictions;
+    uint64_t sc_right;
+    uint64_t sc_wrong;
+    uint64_t loop_right;
+    uint64_t loop_wrong;
+} bp_side_stats_t;
+
+// Get the effect of the side components of predictor 'p'
+//
+void predictor_side_stats(const predictor_t* p, bp_side_stats_t* stats);
+
+// Release predictor 'p' and all of its tables
+//
+void predictor_destroy(predictor_t* p);
+
 //------------------------------------//
 //    Predictor Function Prototypes   //
 //------------------------------------//
 
+// These operate on a single predictor of type bpType
+
 // Initialize the predictor
 //
 void init_predictor();
@@ -0,0 +1,116 @@
+//========================================================//
+//  predstream.c                                          //
+//  Source file for bit-packed prediction streams         //
+//                                                        //
+//  Predictions are packed 64 to a word, so a run writes  //
+//  a bit where --verbose prints two characters           //
+//========================================================//
+
+#define _GNU_SOURCE
+#include "predstream.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//------------------------------------//
+//             Writing                //
+//------------------------------------//
+
+predstream_t* predstream_open(const char* path, int num_predictors)
+{
+    writer_t* out = writer_open(path);
+    if (out == NULL)
+    {
+        return NULL;
+    }
+
+    predstream_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, PREDSTREAM_MAGIC, sizeof(hdr.magic));
+    hdr.version = PREDSTREAM_VERSION;
+    hdr.num_predictors = num_predictors;
+    writer_write(out, &hdr, sizeof(hdr));
+
+    predstream_t* ps = (predstream_t*)calloc(1, sizeof(predstream_t));
+    ps->out = out;
+    return ps;
+}
+
+int predstream_close(predstream_t* ps)
+{
+    if (ps->bits > 0)
+    {
+        writer_write(ps->out, &ps->word, sizeof(ps->word));
+    }
+    predstream_trailer_t trl = {ps->num_predictions};
+    writer_write(ps->out, &trl, sizeof(trl));
+
+    int ok = writer_close(ps->out);
+    free(ps);
+    return ok;
+}
+
+//------------------------------------//
+//             Reading                //
+//------------------------------------//
+
+int predstream_map(const char* path, predstream_map_t* map)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        perror(path);
+        return 0;
+    }
+
+    struct stat st;
+    size_t min = sizeof(predstream_header_t) + sizeof(predstream_trailer_t);
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < min)
+    {
+        fprintf(stderr, "%s is not a prediction stream\n", path);
+        close(fd);
+        return 0;
+    }
+    uint8_t* mem = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+    {
+        perror(path);
+        return 0;
+    }
+
+    map->hdr = (const predstream_header_t*)mem;
+    map->words = (const uint64_t*)(mem + sizeof(predstream_header_t));
+    map->size = st.st_size;
+    memcpy(&map->num_predictions, mem + st.st_size - sizeof(uint64_t),
+           sizeof(uint64_t));
+
+    // the words must hold exactly the predictions in the trailer
+    uint64_t words = (map->num_predictions + 63) / 64;
+    if (memcmp(map->hdr->magic, PREDSTREAM_MAGIC, 8) != 0 ||
+        map->hdr->version != PREDSTREAM_VERSION)
+    {
+        fprintf(stderr, "%s is not a version %d prediction stream\n", path,
+                PREDSTREAM_VERSION);
+    }
+    else if (min + words * sizeof(uint64_t) != map->size)
+    {
+        fprintf(stderr, "Truncated prediction stream %s\n", path);
+    }
+    else
+    {
+        return 1;
+    }
+
+    predstream_unmap(map);
+    return 0;
+}
+
+void predstream_unmap(predstream_map_t* map)
+{
+    munmap((void*)map->hdr, map->size);
+}
@@ -0,0 +1,98 @@
+//========================================================//
+//  predstream.h                                          //
+//  Header file for bit-packed prediction streams         //
+//                                                        //
+//  Records every prediction of a run as one bit, written //
+//  through the asynchronous writer                       //
+//========================================================//
+
+#ifndef PREDSTREAM_H
+#define PREDSTREAM_H
+
+#include "writer.h"
+#include <stdint.h>
+
+//------------------------------------//
+//          Stream Format             //
+//------------------------------------//
+
+#define PREDSTREAM_MAGIC   "BPPRED\0\0"
+#define PREDSTREAM_VERSION 1
+
+// Header of a prediction stream. It is followed by the predictions in
+// the order --verbose prints them, branch by branch and predictor by
+// predictor, packed into 64-bit little endian words starting at the
+// least significant bit, and by the trailer. The count is only known
+// at the end, so that the stream can be written to a pipe.
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t num_predictors;
+} predstream_header_t;
+
+typedef struct
+{
+    uint64_t num_predictions;
+} predstream_trailer_t;
+
+//------------------------------------//
+//             Writing                //
+//------------------------------------//
+
+typedef struct
+{
+    writer_t* out;
+    uint64_t word; // predictions not written yet
+    int bits;      // number of them
+    uint64_t num_predictions;
+} predstream_t;
+
+// Create a prediction stream of 'num_predictors' predictions per
+// branch at 'path', or on stdout when 'path' is "-"
+//
+// Returns NULL on failure
+//
+predstream_t* predstream_open(const char* path, int num_predictors);
+
+// Append a prediction to the stream
+//
+static inline void predstream_add(predstream_t* ps, uint8_t prediction)
+{
+    ps->word |= (uint64_t)(prediction & 0x1) << ps->bits;
+    ps->num_predictions++;
+    if (++ps->bits == 64)
+    {
+        writer_write(ps->out, &ps->word, sizeof(ps->word));
+        ps->word = 0;
+        ps->bits = 0;
+    }
+}
+
+// Write the last word and the trailer, and close the stream
+//
+// Returns True if all of the stream was written
+//
+int predstream_close(predstream_t* ps);
+
+//------------------------------------//
+//             Reading                //
+//------------------------------------//
+
+typedef struct
+{
+    const predstream_header_t* hdr;
+    const uint64_t* words;
+    uint64_t num_predictions;
+    size_t size; // of the mapping
+} predstream_map_t;
+
+// Map the prediction stream at 'path' into memory
+//
+// Returns True if Successful
+//
+int predstream_map(const char* path, predstream_map_t* map);
+
+void predstream_unmap(predstream_map_t* map);
+
+#endif
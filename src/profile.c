@@ -0,0 +1,220 @@
+//========================================================//
+//  profile.c                                             //
+//  Source file for the per-branch profiler               //
+//                                                        //
+//  Finds the static branches behind the mispredictions   //
+//  of each predictor                                     //
+//========================================================//
+
+#include "profile.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Slots of a new profile
+#define PROFILE_INITIAL 4096
+
+// A branch and its mispredictions by one predictor, for sorting
+typedef struct
+{
+    uint64_t mispredictions;
+    uint32_t pc;
+    uint32_t slot;
+} hot_t;
+
+static inline uint32_t hash_pc(uint32_t pc)
+{
+    pc ^= pc >> 16;
+    pc *= 0x45d9f3b;
+    pc ^= pc >> 16;
+    return pc;
+}
+
+static void alloc_slots(profile_t* prof, uint32_t capacity)
+{
+    prof->capacity = capacity;
+    prof->size = 0;
+    prof->used = (uint8_t*)calloc(capacity, sizeof(uint8_t));
+    prof->pc = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+    prof->executed = (uint64_t*)calloc(capacity, sizeof(uint64_t));
+    prof->taken = (uint64_t*)calloc(capacity, sizeof(uint64_t));
+    prof->mispredictions = (uint64_t*)calloc(
+        (uint64_t)capacity * prof->num_predictors, sizeof(uint64_t));
+}
+
+static void free_slots(profile_t* prof)
+{
+    free(prof->used);
+    free(prof->pc);
+    free(prof->executed);
+    free(prof->taken);
+    free(prof->mispredictions);
+}
+
+// Get the slot of 'pc', or the empty slot where it belongs
+//
+static inline uint32_t find_slot(const profile_t* prof, uint32_t pc)
+{
+    uint32_t mask = prof->capacity - 1;
+    uint32_t slot = hash_pc(pc) & mask;
+    while (prof->used[slot] && prof->pc[slot] != pc)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Double the table, moving every branch to its new slot
+//
+static void grow(profile_t* prof)
+{
+    profile_t old = *prof;
+    int n = prof->num_predictors;
+
+    alloc_slots(prof, old.capacity * 2);
+    for (uint32_t s = 0; s < old.capacity; s++)
+    {
+        if (!old.used[s])
+            continue;
+
+        uint32_t slot = find_slot(prof, old.pc[s]);
+        prof->used[slot] = 1;
+        prof->pc[slot] = old.pc[s];
+        prof->executed[slot] = old.executed[s];
+        prof->taken[slot] = old.taken[s];
+        memcpy(&prof->mispredictions[(uint64_t)slot * n],
+               &old.mispredictions[(uint64_t)s * n], n * sizeof(uint64_t));
+        prof->size++;
+    }
+    free_slots(&old);
+}
+
+profile_t* profile_create(int num_predictors)
+{
+    profile_t* prof = (profile_t*)calloc(1, sizeof(profile_t));
+    prof->num_predictors = num_predictors;
+    alloc_slots(prof, PROFILE_INITIAL);
+    return prof;
+}
+
+void profile_destroy(profile_t* prof)
+{
+    free_slots(prof);
+    free(prof);
+}
+
+uint32_t profile_branch(profile_t* prof, uint32_t pc, uint8_t outcome)
+{
+    uint32_t slot = find_slot(prof, pc);
+    if (!prof->used[slot])
+    {
+        if (2 * (prof->size + 1) > prof->capacity)
+        {
+            grow(prof);
+            slot = find_slot(prof, pc);
+        }
+        prof->used[slot] = 1;
+        prof->pc[slot] = pc;
+        prof->size++;
+    }
+
+    prof->executed[slot]++;
+    prof->taken[slot] += outcome & 0x1;
+    return slot;
+}
+
+// Most mispredicted first, then by PC so the order is stable
+//
+static int compare_hot(const void* a, const void* b)
+{
+    const hot_t* x = (const hot_t*)a;
+    const hot_t* y = (const hot_t*)b;
+    if (x->mispredictions != y->mispredictions)
+        return x->mispredictions < y->mispredictions ? 1 : -1;
+    return x->pc < y->pc ? -1 : x->pc > y->pc;
+}
+
+void profile_report(const profile_t* prof, const bp_config_t* cfgs, int top,
+                    FILE* out)
+{
+    int n = prof->num_predictors;
+    hot_t* hot = (hot_t*)malloc((prof->size + 1) * sizeof(hot_t));
+
+    for (int i = 0; i < n; i++)
+    {
+        uint64_t total = 0;
+        uint32_t count = 0;
+        for (uint32_t s = 0; s < prof->capacity; s++)
+        {
+            if (!prof->used[s])
+                continue;
+            hot[count].mispredictions =
+                prof->mispredictions[(uint64_t)s * n + i];
+            hot[count].pc = prof->pc[s];
+            hot[count].slot = s;
+            total += hot[count].mispredictions;
+            count++;
+        }
+        qsort(hot, count, sizeof(hot_t), compare_hot);
+
+        char name[64];
+        predictor_config_name(&cfgs[i], name, sizeof(name));
+        fprintf(out, "\nHot branches of %s (%u static branches)\n", name,
+                count);
+        fprintf(out, "%-10s %12s %8s %8s %12s %8s %8s %8s\n", "PC",
+                "Executed", "Taken %", "Bias %", "Incorrect", "Rate",
+                "Share %", "Cumul %");
+
+        uint64_t cumul = 0;
+        for (uint32_t h = 0; h < count && h < (uint32_t)top; h++)
+        {
+            uint32_t s = hot[h].slot;
+            uint64_t executed = prof->executed[s];
+            uint64_t taken = prof->taken[s];
+            uint64_t bias = taken > executed - taken ? taken : executed - taken;
+            if (hot[h].mispredictions == 0)
+                break;
+
+            cumul += hot[h].mispredictions;
+            fprintf(out, "0x%08x %12llu %8.2f %8.2f %12llu %8.3f %8.2f %8.2f\n",
+                    hot[h].pc, (unsigned long long)executed,
+                    100.0 * taken / executed, 100.0 * bias / executed,
+                    (unsigned long long)hot[h].mispredictions,
+                    100.0 * hot[h].mispredictions / executed,
+                    100.0 * hot[h].mispredictions / total,
+                    100.0 * cumul / total);
+        }
+    }
+
+    free(hot);
+}
+
+int profile_write_csv(const profile_t* prof, const bp_config_t* cfgs,
+                      const char* path)
+{
+    FILE* out = fopen(path, "w");
+    if (out == NULL)
+    {
+        perror(path);
+        return 0;
+    }
+
+    int n = prof->num_predictors;
+    fprintf(out, "predictor,pc,executed,taken,mispredictions\n");
+    for (int i = 0; i < n; i++)
+    {
+        char name[64];
+        predictor_config_name(&cfgs[i], name, sizeof(name));
+        for (uint32_t s = 0; s < prof->capacity; s++)
+        {
+            if (!prof->used[s])
+                continue;
+            fprintf(out, "%s,0x%08x,%llu,%llu,%llu\n", name, prof->pc[s],
+                    (unsigned long long)prof->executed[s],
+                    (unsigned long long)prof->taken[s],
+                    (unsigned long long)
+                        prof->mispredictions[(uint64_t)s * n + i]);
+        }
+    }
+
+    return fclose(out) == 0;
+}
@@ -0,0 +1,64 @@
+//========================================================//
+//  profile.h                                             //
+//  Header file for the per-branch profiler               //
+//                                                        //
+//  Counts executions, taken outcomes and mispredictions  //
+//  of every static branch for each simulated predictor   //
+//========================================================//
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "predictor.h"
+#include <stdint.h>
+#include <stdio.h>
+
+// Per-PC counters in an open-addressing hash table with linear probing,
+// grown to keep it at most half full. The mispredictions of all the
+// predictors of a slot are stored together, num_predictors per slot.
+typedef struct
+{
+    int num_predictors;
+    uint32_t capacity; // power of two
+    uint32_t size;     // slots in use
+
+    uint8_t* used;
+    uint32_t* pc;
+    uint64_t* executed;
+    uint64_t* taken;
+    uint64_t* mispredictions;
+} profile_t;
+
+// Create a profile of 'num_predictors' predictors
+//
+profile_t* profile_create(int num_predictors);
+
+void profile_destroy(profile_t* prof);
+
+// Count an execution of the branch at 'pc' with 'outcome'
+//
+// Returns the slot of the branch, for profile_miss()
+//
+uint32_t profile_branch(profile_t* prof, uint32_t pc, uint8_t outcome);
+
+// Count a misprediction by predictor 'i' of the branch in 'slot'
+//
+static inline void profile_miss(profile_t* prof, uint32_t slot, int i)
+{
+    prof->mispredictions[(uint64_t)slot * prof->num_predictors + i]++;
+}
+
+// Print the 'top' branches with the most mispredictions of each of the
+// predictors in 'cfgs', with their bias and share of the mispredictions
+//
+void profile_report(const profile_t* prof, const bp_config_t* cfgs, int top,
+                    FILE* out);
+
+// Write the counters of every branch and predictor as CSV to 'path'
+//
+// Returns True if Successful
+//
+int profile_write_csv(const profile_t* prof, const bp_config_t* cfgs,
+                      const char* path);
+
+#endif
@@ -0,0 +1,198 @@
+//========================================================//
+//  serve.c                                               //
+//  Source file for the predictor server                  //
+//                                                        //
+//  Each connection is served by its own thread with its  //
+//  own predictors, one request at a time                 //
+//========================================================//
+
+#define _GNU_SOURCE
+#include "serve.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Most predictors served to one connection
+#define SERVE_MAX_PREDICTORS 16
+
+typedef struct
+{
+    int fd;
+    const bp_config_t* cfgs;
+    int num_cfgs;
+} conn_t;
+
+static const char* socketPath = NULL;
+
+static void remove_socket(int sig)
+{
+    unlink(socketPath);
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+// Answer the requests of one connection until it closes
+//
+static void* serve_conn(void* arg)
+{
+    conn_t* conn = (conn_t*)arg;
+    int num = conn->num_cfgs;
+    predictor_t* bp[SERVE_MAX_PREDICTORS];
+    for (int i = 0; i < num; i++)
+    {
+        bp[i] = predictor_create(&conn->cfgs[i]);
+    }
+
+    uint32_t* pcs = (uint32_t*)malloc(SERVE_MAX_BATCH * sizeof(uint32_t));
+    uint8_t* outcomes = (uint8_t*)malloc(serve_bytes(SERVE_MAX_BATCH));
+    uint8_t* preds =
+        (uint8_t*)malloc(serve_bytes((uint64_t)SERVE_MAX_BATCH * num));
+
+    serve_hello_t hello;
+    memset(&hello, 0, sizeof(hello));
+    memcpy(hello.magic, SERVE_MAGIC, sizeof(hello.magic));
+    hello.version = SERVE_VERSION;
+    hello.num_predictors = num;
+    int ok = serve_write(conn->fd, &hello, sizeof(hello));
+
+    serve_msg_t msg;
+    while (ok && serve_read(conn->fd, &msg, sizeof(msg)))
+    {
+        int predict = msg.op == SERVE_PREDICT || msg.op == SERVE_PREDICT_TRAIN;
+        int train = msg.op == SERVE_TRAIN || msg.op == SERVE_PREDICT_TRAIN;
+        int reset = msg.op == SERVE_RESET;
+        if ((!predict && !train && !reset) || (reset && msg.count != 0) ||
+            msg.count > SERVE_MAX_BATCH)
+        {
+            serve_msg_t reply = {SERVE_INVALID, 0};
+            serve_write(conn->fd, &reply, sizeof(reply));
+            break;
+        }
+
+        if (reset)
+        {
+            for (int i = 0; i < num; i++)
+            {
+                predictor_reset(bp[i]);
+            }
+            serve_msg_t reply = {SERVE_OK, 0};
+            ok = serve_write(conn->fd, &reply, sizeof(reply));
+            continue;
+        }
+
+        if (!serve_read(conn->fd, pcs, msg.count * sizeof(uint32_t)) ||
+            (train && !serve_read(conn->fd, outcomes, serve_bytes(msg.count))))
+        {
+            break;
+        }
+
+        size_t len = predict ? serve_bytes((uint64_t)msg.count * num) : 0;
+        memset(preds, 0, len);
+        for (uint32_t b = 0; b < msg.count; b++)
+        {
+            // predict requests carry no outcomes
+            uint8_t outcome =
+                train ? (outcomes[b / 8] >> (b % 8)) & 0x1 : NOTTAKEN;
+            for (int i = 0; i < num; i++)
+            {
+                // the same calls as the loop in main() for each request
+                uint8_t prediction = NOTTAKEN;
+                if (predict && train)
+                    prediction =
+                        predictor_predict_and_update(bp[i], pcs[b], outcome);
+                else if (predict)
+                    prediction = predictor_predict(bp[i], pcs[b]);
+                else
+                    predictor_train(bp[i], pcs[b], outcome);
+
+                uint64_t bit = (uint64_t)b * num + i;
+                preds[bit / 8] |= prediction << (bit % 8);
+            }
+        }
+        serve_msg_t reply = {SERVE_OK, predict ? msg.count : 0};
+        ok = serve_write(conn->fd, &reply, sizeof(reply)) &&
+             serve_write(conn->fd, preds, len);
+    }
+
+    for (int i = 0; i < num; i++)
+    {
+        predictor_destroy(bp[i]);
+    }
+    free(pcs);
+    free(outcomes);
+    free(preds);
+    close(conn->fd);
+    free(conn);
+    return NULL;
+}
+
+int serve_run(const char* path, const bp_config_t* cfgs, int num_cfgs)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path) ||
+        num_cfgs > SERVE_MAX_PREDICTORS)
+    {
+        fprintf(stderr, "Cannot serve on %s\n", path);
+        return 0;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return 0;
+    }
+    // a socket left behind by an earlier server
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(fd, 16) != 0)
+    {
+        perror(path);
+        close(fd);
+        return 0;
+    }
+
+    socketPath = path;
+    signal(SIGINT, remove_socket);
+    signal(SIGTERM, remove_socket);
+    // a client going away must not stop the server
+    signal(SIGPIPE, SIG_IGN);
+    fprintf(stderr, "Serving %d predictor%s on %s\n", num_cfgs,
+            num_cfgs > 1 ? "s" : "", path);
+
+    for (;;)
+    {
+        int client = accept(fd, NULL, NULL);
+        if (client < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("accept");
+            break;
+        }
+
+        conn_t* conn = (conn_t*)malloc(sizeof(conn_t));
+        conn->fd = client;
+        conn->cfgs = cfgs;
+        conn->num_cfgs = num_cfgs;
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, serve_conn, conn) != 0)
+        {
+            close(client);
+            free(conn);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+
+    close(fd);
+    unlink(path);
+    return 0;
+}
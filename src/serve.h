@@ -0,0 +1,119 @@
+//========================================================//
+//  serve.h                                               //
+//  Header file for the predictor server                  //
+//                                                        //
+//  Serves batched predict and train requests over a      //
+//  UNIX domain socket to an external simulator           //
+//========================================================//
+
+#ifndef SERVE_H
+#define SERVE_H
+
+#include "predictor.h"
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+
+//------------------------------------//
+//             Protocol               //
+//------------------------------------//
+
+// On connecting, the server sends a serve_hello_t and creates cold
+// predictors for the connection. The client then sends requests, each a
+// serve_msg_t followed by 'count' 32-bit PCs and, for requests that
+// train, 'count' outcomes packed 8 to a byte from the least significant
+// bit. Every request is answered with a serve_msg_t holding the status
+// and, for requests that predict, 'count' times the number of
+// predictors predictions packed the same way, branch by branch and
+// predictor by predictor as --verbose prints them. Integers are in the
+// byte order of the host, as both ends run on it.
+
+#define SERVE_MAGIC   "BPSERVE\0"
+#define SERVE_VERSION 1
+
+// Most branches in one request
+#define SERVE_MAX_BATCH (1 << 16)
+
+// Requests
+#define SERVE_PREDICT       1 // predict without training
+#define SERVE_TRAIN         2 // train without predicting
+#define SERVE_PREDICT_TRAIN 3 // predict then train, branch by branch
+#define SERVE_RESET         4 // back to cold predictors, count is 0
+
+// Statuses of the replies
+#define SERVE_OK      0
+#define SERVE_INVALID 1 // unknown request or bad count
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t num_predictors;
+} serve_hello_t;
+
+typedef struct
+{
+    uint32_t op; // request, or status of a reply
+    uint32_t count;
+} serve_msg_t;
+
+// Get the number of bytes holding 'bits' packed bits
+//
+static inline size_t serve_bytes(uint64_t bits)
+{
+    return (bits + 7) / 8;
+}
+
+// Read exactly 'len' bytes from 'fd'
+//
+// Returns True if Successful, False on an error or the end of the stream
+//
+static inline int serve_read(int fd, void* buf, size_t len)
+{
+    char* p = (char*)buf;
+    while (len > 0)
+    {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        p += n;
+        len -= n;
+    }
+    return 1;
+}
+
+// Write exactly 'len' bytes to 'fd'
+//
+// Returns True if Successful
+//
+static inline int serve_write(int fd, const void* buf, size_t len)
+{
+    const char* p = (const char*)buf;
+    while (len > 0)
+    {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        p += n;
+        len -= n;
+    }
+    return 1;
+}
+
+//------------------------------------//
+//              Server                //
+//------------------------------------//
+
+// Listen on the UNIX domain socket at 'path' and serve every connection
+// on its own thread with its own predictors of the 'num_cfgs'
+// geometries in 'cfgs'. Only returns on failure.
+//
+// Returns False if the socket could not be created
+//
+int serve_run(const char* path, const bp_config_t* cfgs, int num_cfgs);
+
+#endif
@@ -0,0 +1,101 @@
+//========================================================//
+//  shard.c                                               //
+//  Source file for sharded simulation                    //
+//                                                        //
+//  Every shard and predictor is a job of the pool, all   //
+//  of them reading the same in-memory trace              //
+//========================================================//
+
+#include "shard.h"
+#include "pool.h"
+#include "sim.h"
+#include <stdlib.h>
+
+typedef struct
+{
+    const trace_mem_t* mem;
+    const bp_config_t* cfgs;
+    int num_cfgs;
+    int num_shards;
+    int num_exact; // sequential jobs ahead of the shards, 0 or num_cfgs
+    uint64_t overlap;
+    uint64_t* counts; // per shard and predictor
+    uint64_t* exact;
+} shard_t;
+
+static void shard_job(void* arg, int job)
+{
+    shard_t* shard = (shard_t*)arg;
+
+    // the sequential runs are the longest, so they go first
+    if (job < shard->num_exact)
+    {
+        predictor_t* bp = predictor_create(&shard->cfgs[job]);
+        shard->exact[job] = sim_run(bp, shard->mem);
+        predictor_destroy(bp);
+        return;
+    }
+    job -= shard->num_exact;
+
+    int s = job / shard->num_cfgs;
+    int i = job % shard->num_cfgs;
+    uint64_t n = shard->mem->num_branches;
+    uint64_t first = n * s / shard->num_shards;
+    uint64_t last = n * (s + 1) / shard->num_shards;
+
+    predictor_t* bp = predictor_create(&shard->cfgs[i]);
+    shard->counts[job] =
+        sim_run_range(bp, shard->mem, first, last - first, shard->overlap);
+    predictor_destroy(bp);
+}
+
+void shard_run(const trace_mem_t* mem, const bp_config_t* cfgs,
+               int num_cfgs, int num_shards, uint64_t overlap,
+               int num_threads, uint64_t* mispredictions, uint64_t* exact)
+{
+    shard_t shard;
+    shard.mem = mem;
+    shard.cfgs = cfgs;
+    shard.num_cfgs = num_cfgs;
+    shard.num_shards = num_shards;
+    shard.num_exact = exact != NULL ? num_cfgs : 0;
+    shard.overlap = overlap;
+    shard.counts =
+        (uint64_t*)calloc((size_t)num_shards * num_cfgs, sizeof(uint64_t));
+    shard.exact = exact;
+
+    pool_run(shard.num_exact + num_shards * num_cfgs, num_threads, shard_job,
+             &shard);
+
+    // Merge the shards
+    for (int i = 0; i < num_cfgs; i++)
+    {
+        mispredictions[i] = 0;
+        for (int s = 0; s < num_shards; s++)
+        {
+            mispredictions[i] += shard.counts[s * num_cfgs + i];
+        }
+    }
+
+    free(shard.counts);
+}
+
+void shard_report(FILE* out, const bp_config_t* cfgs, int num_cfgs,
+                  uint64_t num_branches, const uint64_t* mispredictions,
+                  const uint64_t* exact)
+{
+    int width = predictor_name_width(cfgs, num_cfgs);
+    fprintf(out, "%-*s %10s %10s %10s %10s\n", width, "Predictor",
+            "Sequential", "Sharded", "Difference", "Deviation");
+    for (int i = 0; i < num_cfgs; i++)
+    {
+        char name[64];
+        predictor_config_name(&cfgs[i], name, sizeof(name));
+        int64_t diff = (int64_t)(mispredictions[i] - exact[i]);
+        // in points of misprediction rate
+        double dev = num_branches ? 100.0 * diff / num_branches : 0.0;
+        fprintf(out, "%-*s %10llu %10llu %+10lld %+10.4f\n", width, name,
+                (unsigned long long)exact[i],
+                (unsigned long long)mispredictions[i], (long long)diff, dev);
+    }
+}
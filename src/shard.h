@@ -0,0 +1,38 @@
+//========================================================//
+//  shard.h                                               //
+//  Header file for sharded simulation                    //
+//                                                        //
+//  Splits one long trace into shards simulated in        //
+//  parallel, each warmed on the branches before it       //
+//========================================================//
+
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "predictor.h"
+#include "trace.h"
+#include <stdint.h>
+#include <stdio.h>
+
+// Split the trace 'mem' into 'num_shards' shards of consecutive branches
+// and simulate every predictor in 'cfgs' over each shard on the
+// work-stealing pool of 'num_threads' threads. A shard starts from cold
+// predictors, trains them on the 'overlap' branches before it and then
+// counts the mispredictions of its own branches.
+//
+// Writes the sum over the shards for cfgs[i] to mispredictions[i]. When
+// 'exact' is not NULL, every predictor is also simulated over the whole
+// trace in sequence, and its count is written to exact[i].
+//
+void shard_run(const trace_mem_t* mem, const bp_config_t* cfgs,
+               int num_cfgs, int num_shards, uint64_t overlap,
+               int num_threads, uint64_t* mispredictions, uint64_t* exact);
+
+// Print how far the sharded counts 'mispredictions' are from the counts
+// 'exact' of a sequential run, over 'num_branches' branches
+//
+void shard_report(FILE* out, const bp_config_t* cfgs, int num_cfgs,
+                  uint64_t num_branches, const uint64_t* mispredictions,
+                  const uint64_t* exact);
+
+#endif
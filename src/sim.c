@@ -0,0 +1,55 @@
+//========================================================//
+//  sim.c                                                 //
+//  Source file for the simulation loops                  //
+//                                                        //
+//  Drives predictors over traces held in memory          //
+//========================================================//
+
+#include "sim.h"
+
+uint64_t sim_run(predictor_t* bp, const trace_mem_t* mem)
+{
+    uint64_t mispredictions = 0;
+
+    for (uint64_t b = 0; b < mem->num_blocks; b++)
+    {
+        const trace_block_t* blk = &mem->blocks[b];
+        int count = trace_mem_count(mem, b);
+
+        mispredictions += predictor_run(bp, blk->pc, blk->taken, count);
+    }
+
+    return mispredictions;
+}
+
+uint64_t sim_run_range(predictor_t* bp, const trace_mem_t* mem,
+                       uint64_t first, uint64_t count, uint64_t warmup)
+{
+    uint64_t mispredictions = 0;
+    uint64_t start = warmup < first ? first - warmup : 0;
+    uint64_t end = first + count;
+
+    // blocks are of fixed size, so the block of any branch is known
+    for (uint64_t n = start; n < first; n++)
+    {
+        const trace_block_t* blk = &mem->blocks[n / TRACE_BLOCK];
+        int i = n % TRACE_BLOCK;
+        predictor_train(bp, blk->pc[i], (blk->taken >> i) & 0x1);
+    }
+
+    // the measured branches go through the block loop, a block or the
+    // part of one inside the range at a time
+    for (uint64_t n = first; n < end;)
+    {
+        const trace_block_t* blk = &mem->blocks[n / TRACE_BLOCK];
+        int i = n % TRACE_BLOCK;
+        int len = TRACE_BLOCK - i;
+        if ((uint64_t)len > end - n)
+            len = (int)(end - n);
+
+        mispredictions += predictor_run(bp, blk->pc + i, blk->taken >> i, len);
+        n += len;
+    }
+
+    return mispredictions;
+}
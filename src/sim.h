@@ -0,0 +1,30 @@
+//========================================================//
+//  sim.h                                                 //
+//  Header file for the simulation loops                  //
+//                                                        //
+//  Drives predictors over traces held in memory          //
+//========================================================//
+
+#ifndef SIM_H
+#define SIM_H
+
+#include "predictor.h"
+#include "trace.h"
+#include <stdint.h>
+
+// Predict and train 'bp' on every branch of 'mem'
+//
+// Returns the number of mispredictions
+//
+uint64_t sim_run(predictor_t* bp, const trace_mem_t* mem);
+
+// Train 'bp' on the 'warmup' branches before branch 'first' of 'mem'
+// (or on as many as there are), then predict and train it on the
+// 'count' branches from 'first' on
+//
+// Returns the number of mispredictions over the 'count' branches
+//
+uint64_t sim_run_range(predictor_t* bp, const trace_mem_t* mem,
+                       uint64_t first, uint64_t count, uint64_t warmup);
+
+#endif
@@ -0,0 +1,145 @@
+//========================================================//
+//  state.c                                               //
+//  Source file for predictor checkpoints                 //
+//                                                        //
+//  Checkpoints are written with stdio and read back by   //
+//  mapping the file, copying straight into the tables    //
+//========================================================//
+
+#define _GNU_SOURCE
+#include "state.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Get the size of the state of 'p'
+//
+static size_t state_size(predictor_t* p)
+{
+    bp_state_t s = {NULL, 0, 0, 0};
+    predictor_state(p, &s);
+    return s.pos;
+}
+
+static size_t padded(size_t len)
+{
+    return (len + STATE_ALIGN - 1) & ~(size_t)(STATE_ALIGN - 1);
+}
+
+int state_save(const char* path, predictor_t** bp, int num)
+{
+    FILE* out = fopen(path, "wb");
+    if (out == NULL)
+    {
+        perror(path);
+        return 0;
+    }
+
+    state_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, STATE_MAGIC, sizeof(hdr.magic));
+    hdr.version = STATE_VERSION;
+    hdr.num_predictors = num;
+    int ok = fwrite(&hdr, sizeof(hdr), 1, out) == 1;
+
+    for (int i = 0; ok && i < num; i++)
+    {
+        state_record_t rec;
+        memset(&rec, 0, sizeof(rec));
+        predictor_config_name(predictor_config(bp[i]), rec.config,
+                              sizeof(rec.config));
+        rec.length = state_size(bp[i]);
+
+        // zeroed so the padding is written as zeros
+        size_t len = padded(rec.length);
+        bp_state_t s = {(uint8_t*)calloc(len ? len : 1, 1), 0, len, 0};
+        predictor_state(bp[i], &s);
+
+        ok = fwrite(&rec, sizeof(rec), 1, out) == 1 &&
+             fwrite(s.buf, 1, len, out) == len;
+        free(s.buf);
+    }
+
+    ok = fclose(out) == 0 && ok;
+    if (!ok)
+    {
+        fprintf(stderr, "Failed writing %s\n", path);
+    }
+    return ok;
+}
+
+int state_load(const char* path, predictor_t** bp, int num)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        perror(path);
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(state_header_t))
+    {
+        fprintf(stderr, "%s is not a predictor checkpoint\n", path);
+        close(fd);
+        return 0;
+    }
+    uint8_t* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        perror(path);
+        return 0;
+    }
+
+    const state_header_t* hdr = (const state_header_t*)map;
+    int ok = 1;
+    if (memcmp(hdr->magic, STATE_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->version != STATE_VERSION)
+    {
+        fprintf(stderr, "%s is not a version %d predictor checkpoint\n",
+                path, STATE_VERSION);
+        ok = 0;
+    }
+    else if (hdr->num_predictors != (uint32_t)num)
+    {
+        fprintf(stderr, "%s holds %u predictors, not %d\n", path,
+                hdr->num_predictors, num);
+        ok = 0;
+    }
+
+    size_t pos = sizeof(state_header_t);
+    for (int i = 0; ok && i < num; i++)
+    {
+        char name[64];
+        predictor_config_name(predictor_config(bp[i]), name, sizeof(name));
+
+        const state_record_t* rec = (const state_record_t*)(map + pos);
+        if (pos + sizeof(*rec) > (size_t)st.st_size ||
+            pos + sizeof(*rec) + padded(rec->length) > (size_t)st.st_size)
+        {
+            fprintf(stderr, "Truncated predictor checkpoint %s\n", path);
+            ok = 0;
+            break;
+        }
+        if (strncmp(rec->config, name, sizeof(rec->config)) != 0 ||
+            rec->length != state_size(bp[i]))
+        {
+            fprintf(stderr, "Checkpoint %s holds %.*s, not %s\n", path,
+                    (int)sizeof(rec->config), rec->config, name);
+            ok = 0;
+            break;
+        }
+
+        pos += sizeof(*rec);
+        bp_state_t s = {map + pos, 0, rec->length, 1};
+        predictor_state(bp[i], &s);
+        pos += padded(rec->length);
+    }
+
+    munmap(map, st.st_size);
+    return ok;
+}
@@ -0,0 +1,100 @@
+//========================================================//
+//  state.h                                               //
+//  Header file for predictor checkpoints                 //
+//                                                        //
+//  Saves the tables and history registers of predictors  //
+//  to a file and restores them for warm-started runs     //
+//========================================================//
+
+#ifndef STATE_H
+#define STATE_H
+
+#include "counters.h"
+#include "predictor.h"
+#include <stdint.h>
+#include <string.h>
+
+//------------------------------------//
+//        Checkpoint Format           //
+//------------------------------------//
+
+#define STATE_MAGIC   "BPSTATE\0"
+#define STATE_VERSION 1
+
+// Records are padded to this many bytes so that the state of every
+// predictor starts cache line aligned in a mapped checkpoint
+#define STATE_ALIGN 64
+
+// Header of a checkpoint, followed by one record per predictor. All
+// fields are little endian.
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t num_predictors;
+    uint8_t reserved[48];
+} state_header_t;
+
+// Header of the record of one predictor, followed by 'length' bytes of
+// state and padding up to STATE_ALIGN
+typedef struct
+{
+    char config[56]; // spec of the predictor, e.g. "gshare:14"
+    uint64_t length;
+} state_record_t;
+
+//------------------------------------//
+//          State Visitors            //
+//------------------------------------//
+
+// Each predictor lists its state once, in a fixed order, through
+// state_bytes(). The same visit sizes, saves or loads the state
+// depending on the direction of the stream, so a table added to a
+// predictor cannot be missed by one of them.
+typedef struct
+{
+    uint8_t* buf; // NULL when only measuring the size
+    size_t pos;
+    size_t len;
+    int load; // copy from 'buf' into the predictor
+} bp_state_t;
+
+static inline void state_bytes(bp_state_t* s, void* data, size_t n)
+{
+    if (s->buf != NULL && s->pos + n <= s->len)
+    {
+        if (s->load)
+            memcpy(data, s->buf + s->pos, n);
+        else
+            memcpy(s->buf + s->pos, data, n);
+    }
+    s->pos += n;
+}
+
+static inline void state_packed(bp_state_t* s, packed_t* t)
+{
+    state_bytes(s, t->data, packed_bytes(t));
+}
+
+// Visit the state of predictor 'p'
+//
+void predictor_state(predictor_t* p, bp_state_t* s);
+
+//------------------------------------//
+//            Checkpoints             //
+//------------------------------------//
+
+// Save the state of the 'num' predictors in 'bp' to 'path'
+//
+// Returns True if Successful
+//
+int state_save(const char* path, predictor_t** bp, int num);
+
+// Restore the 'num' predictors in 'bp' from the mapped checkpoint at
+// 'path'. The predictors must have the geometries they were saved with.
+//
+// Returns True if Successful
+//
+int state_load(const char* path, predictor_t** bp, int num);
+
+#endif
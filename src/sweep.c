@@ -0,0 +1,175 @@
+//========================================================//
+//  sweep.c                                               //
+//  Source file for the design-space sweeps               //
+//                                                        //
+//  Every geometry is a job of the work-stealing pool,    //
+//  all of them reading the same in-memory trace. Gshare  //
+//  geometries share jobs, simulated in lockstep lanes    //
+//========================================================//
+
+#include "sweep.h"
+#include "lanes.h"
+#include "pool.h"
+#include "sim.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Most geometries a single spec may expand to
+#define SWEEP_MAX_CONFIGS 100000
+
+typedef struct
+{
+    const bp_config_t* cfgs;
+    const trace_mem_t* mem;
+    uint64_t* mispredictions;
+
+    // each job simulates count[job] geometries from first[job] on, in
+    // lanes when there are several
+    int* first;
+    int* count;
+} sweep_t;
+
+int sweep_parse(const char* spec, bp_config_t** cfgs, int* num_cfgs)
+{
+    const char* sep = strchr(spec, ':');
+    size_t len = sep ? (size_t)(sep - spec) : strlen(spec);
+    int type = predictor_parse_type(spec, len);
+    if (type < 0)
+    {
+        return 0;
+    }
+
+    // Parse each parameter as a value or an inclusive range
+    int lo[BP_MAX_PARAMS] = {0}, hi[BP_MAX_PARAMS] = {0};
+    int count = 0;
+    while (sep != NULL)
+    {
+        char* end;
+        if (count == BP_MAX_PARAMS)
+        {
+            return 0;
+        }
+        lo[count] = hi[count] = (int)strtol(sep + 1, &end, 10);
+        if (end == sep + 1)
+        {
+            return 0;
+        }
+        if (!strncmp(end, "..", 2))
+        {
+            const char* start = end + 2;
+            hi[count] = (int)strtol(start, &end, 10);
+            if (end == start || hi[count] < lo[count])
+            {
+                return 0;
+            }
+        }
+        if (*end != ':' && *end != '\0')
+        {
+            return 0;
+        }
+        count++;
+        sep = *end == ':' ? end : NULL;
+    }
+
+    long total = 1;
+    for (int i = 0; i < count; i++)
+    {
+        total *= hi[i] - lo[i] + 1;
+        if (total > SWEEP_MAX_CONFIGS)
+        {
+            return 0;
+        }
+    }
+
+    // Enumerate the cross product of all ranges
+    *cfgs = (bp_config_t*)realloc(*cfgs,
+                                  (*num_cfgs + total) * sizeof(bp_config_t));
+    int params[BP_MAX_PARAMS];
+    memcpy(params, lo, sizeof(params));
+    for (long n = 0; n < total; n++)
+    {
+        bp_config_t* cfg = &(*cfgs)[(*num_cfgs)++];
+        predictor_default_config(cfg, type);
+        if (!predictor_set_params(cfg, params, count))
+        {
+            (*num_cfgs)--;
+            return 0;
+        }
+
+        for (int i = count - 1; i >= 0; i--)
+        {
+            if (++params[i] <= hi[i])
+                break;
+            params[i] = lo[i];
+        }
+    }
+
+    return 1;
+}
+
+static void sweep_job(void* arg, int job)
+{
+    sweep_t* sweep = (sweep_t*)arg;
+    int first = sweep->first[job];
+
+    if (sweep->count[job] > 1)
+    {
+        lanes_run(&sweep->cfgs[first], sweep->count[job], sweep->mem,
+                  &sweep->mispredictions[first]);
+        return;
+    }
+
+    predictor_t* bp = predictor_create(&sweep->cfgs[first]);
+    sweep->mispredictions[first] = sim_run(bp, sweep->mem);
+    predictor_destroy(bp);
+}
+
+void sweep_run(const bp_config_t* cfgs, int num_cfgs, const trace_mem_t* mem,
+               int num_threads, FILE* out)
+{
+    sweep_t sweep;
+    sweep.cfgs = cfgs;
+    sweep.mem = mem;
+    sweep.mispredictions = (uint64_t*)calloc(num_cfgs, sizeof(uint64_t));
+    sweep.first = (int*)malloc(num_cfgs * sizeof(int));
+    sweep.count = (int*)malloc(num_cfgs * sizeof(int));
+
+    // Group runs of gshare geometries into lanes, but keep at least one
+    // job per thread
+    int width = num_cfgs / (num_threads > 0 ? num_threads : 1);
+    width = width < 1 ? 1 : width > LANES_WIDTH ? LANES_WIDTH : width;
+    int num_jobs = 0;
+    for (int i = 0; i < num_cfgs; num_jobs++)
+    {
+        int n = 1;
+        while (n < width && i + n < num_cfgs &&
+               lanes_supported(&cfgs[i]) && lanes_supported(&cfgs[i + n]))
+        {
+            n++;
+        }
+        sweep.first[num_jobs] = i;
+        sweep.count[num_jobs] = n;
+        i += n;
+    }
+
+    pool_run(num_jobs, num_threads, sweep_job, &sweep);
+
+    fprintf(out, "predictor,config,storage_bits,branches,mispredictions,"
+                 "misprediction_rate\n");
+    for (int i = 0; i < num_cfgs; i++)
+    {
+        char name[64];
+        predictor_config_name(&cfgs[i], name, sizeof(name));
+        double rate = mem->num_branches
+                          ? 100.0 * sweep.mispredictions[i] / mem->num_branches
+                          : 0.0;
+        fprintf(out, "%s,%s,%llu,%llu,%llu,%.3f\n", bpName[cfgs[i].bpType],
+                name, (unsigned long long)predictor_storage_bits(&cfgs[i]),
+                (unsigned long long)mem->num_branches,
+                (unsigned long long)sweep.mispredictions[i], rate);
+    }
+
+    free(sweep.mispredictions);
+    free(sweep.first);
+    free(sweep.count);
+}
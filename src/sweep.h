@@ -0,0 +1,32 @@
+//========================================================//
+//  sweep.h                                               //
+//  Header file for the design-space sweeps               //
+//                                                        //
+//  Evaluates many predictor geometries over one trace    //
+//========================================================//
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "predictor.h"
+#include "trace.h"
+#include <stdio.h>
+
+// Parse a sweep spec and append every geometry it covers to 'cfgs'
+// (grown with realloc). The spec uses the predictor syntax where each
+// parameter is either a value or an inclusive range, e.g.
+//
+//   gshare:8..20
+//   tournament:10..13:8..11:10..11
+//
+// Returns True if Successful
+//
+int sweep_parse(const char* spec, bp_config_t** cfgs, int* num_cfgs);
+
+// Simulate every geometry in 'cfgs' over the shared trace 'mem' using
+// 'num_threads' threads, and write one CSV row per geometry to 'out'
+//
+void sweep_run(const bp_config_t* cfgs, int num_cfgs, const trace_mem_t* mem,
+               int num_threads, FILE* out);
+
+#endif
@@ -0,0 +1,370 @@
+//========================================================//
+//  tage.c                                                //
+//  Source file for the TAGE predictor                    //
+//                                                        //
+//  Long global histories are folded down to the index    //
+//  and tag widths incrementally, one bit per branch      //
+//========================================================//
+
+#include "tage.h"
+#include "counters.h"
+#include <math.h>
+#include <string.h>
+
+#define MAX(a, b) (a > b ? a : b)
+#define MIN(a, b) (a < b ? a : b)
+
+// Ring of global history bits, a power of two longer than any history
+#define TAGE_HIST_BUF 2048
+
+// Branches between halvings of the usefulness counters
+#define TAGE_U_PERIOD (1 << TAGE_U_TICK_BITS)
+
+// A history of 'olength' bits xor'ed down to 'clength' bits. Shifting a
+// bit in only needs the bit leaving the window, so the cost per branch
+// does not depend on the history length.
+typedef struct
+{
+    uint32_t comp;
+    int clength;
+    int olength;
+    int outpoint;
+} folded_t;
+
+struct tage
+{
+    bp_config_t cfg;
+    int num_tables;
+    int hist_len[TAGE_MAX_TABLES];
+
+    packed_t base; // bimodal 2-bit counters
+    packed_t ctr[TAGE_MAX_TABLES];
+    packed_t tag[TAGE_MAX_TABLES];
+    packed_t u[TAGE_MAX_TABLES];
+
+    // Global history, the newest bit at ghist[ptr]
+    uint8_t ghist[TAGE_HIST_BUF];
+    uint32_t ptr;
+    folded_t fold_idx[TAGE_MAX_TABLES];
+    folded_t fold_tag0[TAGE_MAX_TABLES];
+    folded_t fold_tag1[TAGE_MAX_TABLES];
+
+    uint32_t use_alt; // alternate over new entries when the MSB is set
+    uint32_t tick;    // branches since the usefulness counters were halved
+    uint32_t seed;    // allocation randomness
+
+    // Indices and tags of the last lookup
+    uint32_t base_idx;
+    uint32_t index[TAGE_MAX_TABLES];
+    uint32_t tags[TAGE_MAX_TABLES];
+};
+
+//------------------------------------//
+//         Folded Histories           //
+//------------------------------------//
+
+static void folded_init(folded_t* f, int olength, int clength)
+{
+    f->comp = 0;
+    f->olength = olength;
+    f->clength = clength;
+    f->outpoint = olength % clength;
+}
+
+// Shift the newest history bit 'in' into the folded history, and the
+// bit 'out' that left its window out of it
+//
+static inline void folded_update(folded_t* f, uint8_t in, uint8_t out)
+{
+    f->comp = (f->comp << 1) | in;
+    f->comp ^= (uint32_t)out << f->outpoint;
+    f->comp ^= f->comp >> f->clength;
+    f->comp &= (1u << f->clength) - 1;
+}
+
+//------------------------------------//
+//           TAGE Predictor           //
+//------------------------------------//
+
+int tage_valid_config(const bp_config_t* cfg)
+{
+    return cfg->numTables >= 1 && cfg->numTables <= TAGE_MAX_TABLES &&
+           cfg->minHistory >= 1 && cfg->minHistory <= cfg->maxHistory &&
+           cfg->maxHistory <= TAGE_MAX_HISTORY &&
+           cfg->maxHistory - cfg->minHistory >= cfg->numTables - 1 &&
+           cfg->pcIndexBits >= 1 && cfg->pcIndexBits <= TAGE_MAX_INDEX &&
+           cfg->tagBits >= TAGE_MIN_TAG && cfg->tagBits <= TAGE_MAX_TAG;
+}
+
+int tage_history_length(const bp_config_t* cfg, int table)
+{
+    if (cfg->numTables == 1)
+    {
+        return cfg->minHistory;
+    }
+
+    // geometric series from minHistory to maxHistory, strictly increasing
+    double ratio = (double)cfg->maxHistory / cfg->minHistory;
+    int len = cfg->minHistory;
+    for (int j = 1; j <= table; j++)
+    {
+        int next = (int)(cfg->minHistory *
+                             pow(ratio, (double)j / (cfg->numTables - 1)) +
+                         0.5);
+        int left = cfg->numTables - 1 - j;
+        len = MIN(MAX(next, len + 1), cfg->maxHistory - left);
+    }
+    return len;
+}
+
+tage_t* tage_create(const bp_config_t* cfg)
+{
+    if (!tage_valid_config(cfg))
+    {
+        return NULL;
+    }
+
+    tage_t* t = (tage_t*)calloc(1, sizeof(tage_t));
+    t->cfg = *cfg;
+    t->num_tables = cfg->numTables;
+
+    uint32_t entries = 1u << cfg->pcIndexBits;
+    packed_init(&t->base, entries << 2, 2);
+    for (int j = 0; j < t->num_tables; j++)
+    {
+        t->hist_len[j] = tage_history_length(cfg, j);
+        packed_init(&t->ctr[j], entries, TAGE_CTR_BITS);
+        packed_init(&t->tag[j], entries, cfg->tagBits);
+        packed_init(&t->u[j], entries, TAGE_U_BITS);
+    }
+
+    tage_reset(t);
+    return t;
+}
+
+void tage_reset(tage_t* t)
+{
+    packed_fill(&t->base, WN);
+    for (int j = 0; j < t->num_tables; j++)
+    {
+        packed_fill(&t->ctr[j], 0);
+        packed_fill(&t->tag[j], 0);
+        packed_fill(&t->u[j], 0);
+
+        folded_init(&t->fold_idx[j], t->hist_len[j], t->cfg.pcIndexBits);
+        folded_init(&t->fold_tag0[j], t->hist_len[j], t->cfg.tagBits);
+        folded_init(&t->fold_tag1[j], t->hist_len[j], t->cfg.tagBits - 1);
+    }
+
+    memset(t->ghist, 0, sizeof(t->ghist));
+    t->ptr = 0;
+    t->use_alt = 1u << (TAGE_USE_ALT_BITS - 1);
+    t->tick = 0;
+    t->seed = 0x2545f491;
+}
+
+uint8_t tage_lookup(tage_t* t, uint32_t pc, bp_lookup_t* rec)
+{
+    uint32_t mask = (1u << t->cfg.pcIndexBits) - 1;
+    uint32_t tag_mask = (1u << t->cfg.tagBits) - 1;
+
+    t->base_idx = pc & ((mask << 2) | 0x3);
+
+    // find the two longest histories that hit
+    int provider = 0, alt = 0;
+    for (int j = t->num_tables - 1; j >= 0; j--)
+    {
+        t->index[j] = (pc ^ (pc >> (j + 1)) ^ t->fold_idx[j].comp) & mask;
+        t->tags[j] =
+            (pc ^ t->fold_tag0[j].comp ^ (t->fold_tag1[j].comp << 1)) &
+            tag_mask;
+        // tag 0 marks entries never allocated, so no branch may hit them
+        t->tags[j] += t->tags[j] == 0;
+
+        if (alt == 0 && packed_get(&t->tag[j], t->index[j]) == t->tags[j])
+        {
+            if (provider == 0)
+                provider = j + 1;
+            else
+                alt = j + 1;
+        }
+    }
+
+    uint8_t base_pred = packed_msb(&t->base, t->base_idx);
+    rec->provider = provider;
+    rec->alt = alt;
+    rec->alt_pred =
+        alt ? packed_msb(&t->ctr[alt - 1], t->index[alt - 1]) : base_pred;
+
+    if (provider == 0)
+    {
+        rec->index = t->base_idx;
+        rec->provider_pred = base_pred;
+        rec->prediction = base_pred;
+        return rec->prediction;
+    }
+
+    // newly allocated entries are weak and not yet useful, and may do
+    // worse than the alternate
+    rec->index = t->index[provider - 1];
+    uint32_t ctr = packed_get(&t->ctr[provider - 1], rec->index);
+    uint32_t weak = 1u << (TAGE_CTR_BITS - 1);
+    int fresh = (ctr == weak || ctr == weak - 1) &&
+                packed_get(&t->u[provider - 1], rec->index) == 0;
+
+    rec->provider_pred = ctr >= weak;
+    rec->prediction = (fresh && (t->use_alt >> (TAGE_USE_ALT_BITS - 1)))
+                          ? rec->alt_pred
+                          : rec->provider_pred;
+    return rec->prediction;
+}
+
+int tage_weak(const tage_t* t, const bp_lookup_t* rec)
+{
+    if (rec->provider == 0)
+    {
+        uint32_t ctr = packed_get(&t->base, t->base_idx);
+        return ctr == WN || ctr == WT;
+    }
+    uint32_t ctr = packed_get(&t->ctr[rec->provider - 1], rec->index);
+    uint32_t weak = 1u << (TAGE_CTR_BITS - 1);
+    return ctr == weak || ctr == weak - 1;
+}
+
+// Allocate an entry for the mispredicted branch in a table with a longer
+// history than its provider
+//
+static void tage_allocate(tage_t* t, int provider, uint8_t outcome)
+{
+    // start at one of the next two tables at random
+    t->seed ^= t->seed << 13;
+    t->seed ^= t->seed >> 17;
+    t->seed ^= t->seed << 5;
+    int start = provider + (t->seed & 0x1);
+    if (start >= t->num_tables)
+    {
+        start = provider;
+    }
+
+    for (int j = start; j < t->num_tables; j++)
+    {
+        if (packed_get(&t->u[j], t->index[j]) == 0)
+        {
+            uint32_t weak = 1u << (TAGE_CTR_BITS - 1);
+            packed_set(&t->tag[j], t->index[j], t->tags[j]);
+            packed_set(&t->ctr[j], t->index[j], outcome ? weak : weak - 1);
+            return;
+        }
+    }
+
+    // nothing to replace, age the candidates instead
+    for (int j = provider; j < t->num_tables; j++)
+    {
+        packed_count(&t->u[j], t->index[j], 0);
+    }
+}
+
+void tage_update(tage_t* t, const bp_lookup_t* rec, uint8_t outcome)
+{
+    int provider = rec->provider;
+
+    if (provider > 0)
+    {
+        packed_t* ctr = &t->ctr[provider - 1];
+        packed_t* u = &t->u[provider - 1];
+        uint32_t val = packed_get(ctr, rec->index);
+        uint32_t weak = 1u << (TAGE_CTR_BITS - 1);
+        int useful = packed_get(u, rec->index) != 0;
+
+        // learn whether new entries should defer to the alternate
+        if (!useful && (val == weak || val == weak - 1) &&
+            rec->provider_pred != rec->alt_pred)
+        {
+            uint32_t max = (1u << TAGE_USE_ALT_BITS) - 1;
+            if (rec->alt_pred == outcome)
+                t->use_alt += t->use_alt < max;
+            else
+                t->use_alt -= t->use_alt > 0;
+        }
+
+        // entries are useful when they beat the alternate
+        if (rec->provider_pred != rec->alt_pred)
+        {
+            packed_count(u, rec->index, rec->provider_pred == outcome);
+        }
+
+        packed_count(ctr, rec->index, outcome == TAKEN);
+        if (!useful)
+        {
+            if (rec->alt > 0)
+                packed_count(&t->ctr[rec->alt - 1], t->index[rec->alt - 1],
+                             outcome == TAKEN);
+            else
+                packed_count(&t->base, t->base_idx, outcome == TAKEN);
+        }
+    }
+    else
+    {
+        packed_count(&t->base, t->base_idx, outcome == TAKEN);
+    }
+
+    if (rec->prediction != outcome && provider < t->num_tables)
+    {
+        tage_allocate(t, provider, outcome);
+    }
+
+    // let entries that stopped being useful be replaced
+    if (++t->tick == TAGE_U_PERIOD)
+    {
+        t->tick = 0;
+        for (int j = 0; j < t->num_tables; j++)
+        {
+            for (uint32_t e = 0; e < t->u[j].entries; e++)
+            {
+                packed_set(&t->u[j], e, packed_get(&t->u[j], e) >> 1);
+            }
+        }
+    }
+
+    // shift the outcome into the global and folded histories
+    t->ptr = (t->ptr - 1) & (TAGE_HIST_BUF - 1);
+    t->ghist[t->ptr] = outcome & 0x1;
+    for (int j = 0; j < t->num_tables; j++)
+    {
+        uint8_t out = t->ghist[(t->ptr + t->hist_len[j]) & (TAGE_HIST_BUF - 1)];
+        folded_update(&t->fold_idx[j], outcome & 0x1, out);
+        folded_update(&t->fold_tag0[j], outcome & 0x1, out);
+        folded_update(&t->fold_tag1[j], outcome & 0x1, out);
+    }
+}
+
+void tage_state(tage_t* t, bp_state_t* s)
+{
+    state_packed(s, &t->base);
+    for (int j = 0; j < t->num_tables; j++)
+    {
+        state_packed(s, &t->ctr[j]);
+        state_packed(s, &t->tag[j]);
+        state_packed(s, &t->u[j]);
+        state_bytes(s, &t->fold_idx[j].comp, sizeof(uint32_t));
+        state_bytes(s, &t->fold_tag0[j].comp, sizeof(uint32_t));
+        state_bytes(s, &t->fold_tag1[j].comp, sizeof(uint32_t));
+    }
+    state_bytes(s, t->ghist, sizeof(t->ghist));
+    state_bytes(s, &t->ptr, sizeof(t->ptr));
+    state_bytes(s, &t->use_alt, sizeof(t->use_alt));
+    state_bytes(s, &t->tick, sizeof(t->tick));
+    state_bytes(s, &t->seed, sizeof(t->seed));
+}
+
+void tage_destroy(tage_t* t)
+{
+    packed_free(&t->base);
+    for (int j = 0; j < t->num_tables; j++)
+    {
+        packed_free(&t->ctr[j]);
+        packed_free(&t->tag[j]);
+        packed_free(&t->u[j]);
+    }
+    free(t);
+}
@@ -0,0 +1,77 @@
+//========================================================//
+//  tage.h                                                //
+//  Header file for the TAGE predictor                    //
+//                                                        //
+//  Tagged tables indexed with geometrically increasing   //
+//  lengths of global history, over a bimodal base table  //
+//========================================================//
+
+#ifndef TAGE_H
+#define TAGE_H
+
+#include "predictor.h"
+#include "state.h"
+
+// Limits of the geometry
+#define TAGE_MAX_TABLES  12
+#define TAGE_MAX_HISTORY 1024
+#define TAGE_MAX_INDEX   20
+#define TAGE_MIN_TAG     2
+#define TAGE_MAX_TAG     16
+
+// Entry widths of the tagged tables
+#define TAGE_CTR_BITS 3 // prediction counter
+#define TAGE_U_BITS   2 // usefulness counter
+
+// Width of the counter choosing the alternate prediction over newly
+// allocated entries
+#define TAGE_USE_ALT_BITS 4
+
+// Widths of the xorshift seed picking where to allocate, and of the
+// branch count between halvings of the usefulness counters
+#define TAGE_SEED_BITS   32
+#define TAGE_U_TICK_BITS 18
+
+typedef struct tage tage_t;
+
+// Returns True if the TAGE geometry in 'cfg' is valid
+//
+int tage_valid_config(const bp_config_t* cfg);
+
+// Get the history length of tagged table 'table' (0 the shortest)
+//
+int tage_history_length(const bp_config_t* cfg, int table);
+
+// Create a TAGE predictor with the geometry in 'cfg'
+//
+// Returns NULL if the geometry is invalid
+//
+tage_t* tage_create(const bp_config_t* cfg);
+
+// Return the predictor to its initial state
+//
+void tage_reset(tage_t* t);
+
+// Predict the branch at PC 'pc', filling 'rec' with the provider and
+// alternate predictions. Only the predictor's scratch indices change, so
+// a lookup may be repeated before the update.
+//
+uint8_t tage_lookup(tage_t* t, uint32_t pc, bp_lookup_t* rec);
+
+// Returns True if the prediction in 'rec' was read from a counter next
+// to its threshold
+//
+int tage_weak(const tage_t* t, const bp_lookup_t* rec);
+
+// Train with the outcome of the branch of the last lookup, allocate
+// entries on a misprediction and shift the outcome into the histories
+//
+void tage_update(tage_t* t, const bp_lookup_t* rec, uint8_t outcome);
+
+// Visit the tables and history registers of the predictor
+//
+void tage_state(tage_t* t, bp_state_t* s);
+
+void tage_destroy(tage_t* t);
+
+#endif
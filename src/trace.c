@@ -0,0 +1,829 @@
+//========================================================//
+//  trace.c                                               //
+//  Source file for the branch trace readers              //
+//                                                        //
+//  Reads text and packed binary traces, optionally       //
+//  bzip2 compressed. Binary trace files are mapped       //
+//  directly into memory, everything else is decoded by   //
+//  a producer thread into a ring of blocks.              //
+//========================================================//
+
+#define _GNU_SOURCE
+#include "trace.h"
+#include <bzlib.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Handy Global for use in output routines
+const char* traceFormatName[2] = {"Text", "Binary"};
+
+// Size of the read buffers for streamed traces
+#define TRACE_BUF_SIZE (1 << 20)
+
+// Most blocks allocated up front when loading a trace, more as it grows
+#define TRACE_LOAD_BLOCKS (1 << 16)
+
+// Number of blocks in the producer ring, must be a power of 2
+#define TRACE_RING_SIZE 1024
+
+// Times a side of the ring yields before sleeping until the other wakes it
+#define TRACE_RING_SPINS 64
+
+// Single producer / single consumer ring of decoded blocks. 'head' is
+// only written by the producer and 'tail' only by the consumer, each on
+// its own cache line. Every change of 'head', 'tail', 'done' or 'stop'
+// bumps 'seq', and a side that found nothing to do for a while sleeps on
+// 'wake' until 'seq' moves.
+struct trace_ring
+{
+    trace_block_t blk[TRACE_RING_SIZE];
+    int count[TRACE_RING_SIZE];
+    uint64_t head __attribute__((aligned(64))); // next block to fill
+    int done;                                   // producer finished
+    int stop;                                   // consumer closed early
+    uint64_t tail __attribute__((aligned(64))); // next block to drain
+    int hold; // consumer still holds the block before 'tail'
+    uint32_t seq __attribute__((aligned(64)));
+    int sleepers; // sides blocked on 'wake'
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t producer;
+};
+
+//------------------------------------//
+//          Buffered Input            //
+//------------------------------------//
+
+// Decompress into the read buffer until it is full or the input ends.
+// Concatenated bzip2 streams (as written by pbzip2) are decoded in turn.
+//
+static void inflate_buffer(trace_t* trace)
+{
+    bz_stream* bz = (bz_stream*)trace->bz;
+
+    while (trace->buf_len < TRACE_BUF_SIZE)
+    {
+        if (bz->avail_in == 0)
+        {
+            bz->next_in = trace->zbuf;
+            bz->avail_in = fread(trace->zbuf, 1, TRACE_BUF_SIZE, trace->file);
+            if (bz->avail_in == 0)
+            {
+                // the input must end on a stream boundary
+                if (bz->total_in_lo32 != 0 || bz->total_in_hi32 != 0)
+                {
+                    fprintf(stderr, "Truncated bzip2 trace\n");
+                    trace->error = 1;
+                }
+                trace->eof = 1;
+                return;
+            }
+        }
+
+        bz->next_out = trace->buf + trace->buf_len;
+        bz->avail_out = TRACE_BUF_SIZE - trace->buf_len;
+        int ret = BZ2_bzDecompress(bz);
+        trace->buf_len = TRACE_BUF_SIZE - bz->avail_out;
+
+        if (ret == BZ_STREAM_END)
+        {
+            // another stream may follow the one that just ended
+            char* next_in = bz->next_in;
+            unsigned int avail_in = bz->avail_in;
+            BZ2_bzDecompressEnd(bz);
+            memset(bz, 0, sizeof(*bz));
+            BZ2_bzDecompressInit(bz, 0, 0);
+            bz->next_in = next_in;
+            bz->avail_in = avail_in;
+        }
+        else if (ret != BZ_OK)
+        {
+            fprintf(stderr, "bzip2 error %d while reading trace\n", ret);
+            trace->error = 1;
+            trace->eof = 1;
+            return;
+        }
+    }
+}
+
+// Refill the read buffer, keeping any unconsumed bytes
+//
+// Returns the number of bytes available
+//
+static size_t fill_buffer(trace_t* trace)
+{
+    size_t left = trace->buf_len - trace->buf_pos;
+    if (trace->eof)
+    {
+        return left;
+    }
+
+    memmove(trace->buf, trace->buf + trace->buf_pos, left);
+    trace->buf_pos = 0;
+    trace->buf_len = left;
+
+    if (trace->compressed)
+    {
+        inflate_buffer(trace);
+        return trace->buf_len;
+    }
+
+    while (trace->buf_len < TRACE_BUF_SIZE && !trace->eof)
+    {
+        size_t n = fread(trace->buf + trace->buf_len, 1,
+                         TRACE_BUF_SIZE - trace->buf_len, trace->file);
+        if (n == 0)
+        {
+            trace->eof = 1;
+        }
+        trace->buf_len += n;
+    }
+
+    return trace->buf_len;
+}
+
+// Copy 'len' bytes out of the read buffer
+//
+// Returns True if Successful
+//
+static int read_bytes(trace_t* trace, void* dst, size_t len)
+{
+    if (trace->buf_len - trace->buf_pos < len && fill_buffer(trace) < len)
+    {
+        return 0;
+    }
+    memcpy(dst, trace->buf + trace->buf_pos, len);
+    trace->buf_pos += len;
+    return 1;
+}
+
+// Switch a stream that starts with a bzip2 signature over to
+// decompressing it. The bytes already read become the compressed input.
+//
+static void start_inflate(trace_t* trace)
+{
+    bz_stream* bz = (bz_stream*)calloc(1, sizeof(bz_stream));
+    BZ2_bzDecompressInit(bz, 0, 0);
+
+    trace->zbuf = trace->buf;
+    trace->buf = (char*)malloc(TRACE_BUF_SIZE);
+    bz->next_in = trace->zbuf + trace->buf_pos;
+    bz->avail_in = trace->buf_len - trace->buf_pos;
+    trace->buf_len = 0;
+    trace->buf_pos = 0;
+    trace->bz = bz;
+    trace->compressed = 1;
+    trace->eof = 0;
+
+    fill_buffer(trace);
+}
+
+//------------------------------------//
+//            Text Traces             //
+//------------------------------------//
+
+static inline int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+// Parse one "0x<pc> <outcome>" line starting at 'p'
+//
+// Returns True if the line held a branch
+//
+static int parse_line(const char* p, const char* end, uint32_t* pc,
+                      uint8_t* outcome)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    if (end - p < 2 || p[0] != '0' || (p[1] | 0x20) != 'x')
+        return 0;
+    p += 2;
+
+    uint32_t val = 0;
+    int d;
+    const char* start = p;
+    while (p < end && (d = hex_digit(*p)) >= 0)
+    {
+        val = (val << 4) | d;
+        p++;
+    }
+    if (p == start)
+        return 0;
+
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    if (p == end || *p < '0' || *p > '9')
+        return 0;
+
+    uint32_t tmp = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        tmp = tmp * 10 + (*p - '0');
+        p++;
+    }
+
+    *pc = val;
+    *outcome = tmp;
+    return 1;
+}
+
+// Parse up to TRACE_BLOCK lines into 'blk'
+//
+// Returns the number of branches parsed
+//
+static int read_text_block(trace_t* trace, trace_block_t* blk)
+{
+    int n = 0;
+
+    blk->taken = 0;
+    while (n < TRACE_BLOCK)
+    {
+        char* line = trace->buf + trace->buf_pos;
+        size_t left = trace->buf_len - trace->buf_pos;
+        char* nl = memchr(line, '\n', left);
+        if (nl == NULL)
+        {
+            if (!trace->eof && left < TRACE_BUF_SIZE)
+            {
+                fill_buffer(trace);
+                continue;
+            }
+            if (left == 0)
+            {
+                break;
+            }
+            // last line without a newline, or one longer than the buffer
+            nl = line + left;
+        }
+
+        uint32_t pc;
+        uint8_t outcome;
+        if (parse_line(line, nl, &pc, &outcome))
+        {
+            blk->pc[n] = pc;
+            blk->taken |= (uint64_t)(outcome & 0x1) << n;
+            n++;
+        }
+        size_t next = nl + 1 - trace->buf;
+        trace->buf_pos = next < trace->buf_len ? next : trace->buf_len;
+    }
+
+    return n;
+}
+
+//------------------------------------//
+//           Binary Traces            //
+//------------------------------------//
+
+static int check_header(const trace_header_t* hdr)
+{
+    if (hdr->version != TRACE_VERSION || hdr->blockSize != TRACE_BLOCK)
+    {
+        fprintf(stderr, "Unsupported binary trace version %u\n",
+                hdr->version);
+        return 0;
+    }
+    return 1;
+}
+
+static const trace_block_t* next_mapped_block(trace_t* trace, int* count)
+{
+    if (trace->next_block == trace->num_blocks)
+    {
+        return NULL;
+    }
+
+    uint64_t first = trace->next_block * TRACE_BLOCK;
+    uint64_t left = trace->num_branches - first;
+    *count = left < TRACE_BLOCK ? (int)left : TRACE_BLOCK;
+    return &trace->blocks[trace->next_block++];
+}
+
+// Copy the next block of a streamed binary trace into 'blk'
+//
+// Returns the number of branches read
+//
+static int read_binary_block(trace_t* trace, trace_block_t* blk)
+{
+    if (trace->remaining == 0)
+    {
+        return 0;
+    }
+    if (!read_bytes(trace, blk, sizeof(*blk)))
+    {
+        if (!trace->error)
+        {
+            fprintf(stderr, "Truncated binary trace\n");
+            trace->error = 1;
+        }
+        return 0;
+    }
+
+    int n = trace->remaining < TRACE_BLOCK ? (int)trace->remaining
+                                           : TRACE_BLOCK;
+    trace->remaining -= n;
+    return n;
+}
+
+// Try to map a binary trace file into memory
+//
+// Returns True if the file was mapped
+//
+static int map_trace(trace_t* trace, int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+        (size_t)st.st_size < sizeof(trace_header_t))
+    {
+        return 0;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        return 0;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    // the count in the header is checked against the blocks the file can
+    // hold without any arithmetic on it that could wrap
+    const trace_header_t* hdr = map;
+    uint64_t max_blocks =
+        ((uint64_t)st.st_size - sizeof(trace_header_t)) / sizeof(trace_block_t);
+    uint64_t num_blocks = hdr->num_branches / TRACE_BLOCK +
+                          (hdr->num_branches % TRACE_BLOCK != 0);
+    if (num_blocks > max_blocks)
+    {
+        // left to the streamed reader, which reports where it ends
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    trace->map = map;
+    trace->map_len = st.st_size;
+    trace->blocks = (const trace_block_t*)(trace->map + sizeof(*hdr));
+    trace->num_blocks = num_blocks;
+    trace->num_branches = hdr->num_branches;
+    return 1;
+}
+
+//------------------------------------//
+//         Producer Thread            //
+//------------------------------------//
+
+// Wait for the other side of the ring to move 'seq' on from 'seen', the
+// value read before finding nothing to do. The first waits of a stall
+// only yield, later ones sleep.
+//
+static void ring_wait(struct trace_ring* ring, uint32_t seen, int* spins)
+{
+    if (*spins < TRACE_RING_SPINS)
+    {
+        (*spins)++;
+        sched_yield();
+        return;
+    }
+
+    pthread_mutex_lock(&ring->lock);
+    __atomic_add_fetch(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&ring->seq, __ATOMIC_SEQ_CST) == seen)
+    {
+        pthread_cond_wait(&ring->wake, &ring->lock);
+    }
+    __atomic_sub_fetch(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+// Tell the other side of the ring that it may have something to do
+//
+static inline void ring_signal(struct trace_ring* ring)
+{
+    __atomic_add_fetch(&ring->seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->sleepers, __ATOMIC_SEQ_CST) > 0)
+    {
+        pthread_mutex_lock(&ring->lock);
+        pthread_cond_broadcast(&ring->wake);
+        pthread_mutex_unlock(&ring->lock);
+    }
+}
+
+static void* producer_main(void* arg)
+{
+    trace_t* trace = (trace_t*)arg;
+    struct trace_ring* ring = trace->ring;
+    uint64_t head = ring->head;
+
+    while (1)
+    {
+        // wait for a free slot
+        int spins = 0;
+        while (1)
+        {
+            uint32_t seen = __atomic_load_n(&ring->seq, __ATOMIC_SEQ_CST);
+            if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) <
+                    TRACE_RING_SIZE ||
+                __atomic_load_n(&ring->stop, __ATOMIC_ACQUIRE))
+            {
+                break;
+            }
+            ring_wait(ring, seen, &spins);
+        }
+        if (__atomic_load_n(&ring->stop, __ATOMIC_ACQUIRE))
+        {
+            break;
+        }
+
+        int slot = head & (TRACE_RING_SIZE - 1);
+        int n = trace->format == TRACE_BIN
+                    ? read_binary_block(trace, &ring->blk[slot])
+                    : read_text_block(trace, &ring->blk[slot]);
+        if (n == 0)
+        {
+            break;
+        }
+
+        ring->count[slot] = n;
+        __atomic_store_n(&ring->head, ++head, __ATOMIC_RELEASE);
+        ring_signal(ring);
+    }
+
+    __atomic_store_n(&ring->done, 1, __ATOMIC_RELEASE);
+    ring_signal(ring);
+    return NULL;
+}
+
+static const trace_block_t* next_ring_block(trace_t* trace, int* count)
+{
+    struct trace_ring* ring = trace->ring;
+    uint64_t tail = ring->tail;
+
+    // hand the previous block back to the producer
+    if (ring->hold)
+    {
+        __atomic_store_n(&ring->tail, ++tail, __ATOMIC_RELEASE);
+        ring->hold = 0;
+        ring_signal(ring);
+    }
+
+    int spins = 0;
+    while (1)
+    {
+        uint32_t seen = __atomic_load_n(&ring->seq, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) != tail)
+        {
+            break;
+        }
+        if (__atomic_load_n(&ring->done, __ATOMIC_ACQUIRE))
+        {
+            // the producer may have published a block before finishing
+            if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail)
+            {
+                return NULL;
+            }
+            break;
+        }
+        ring_wait(ring, seen, &spins);
+    }
+
+    int slot = tail & (TRACE_RING_SIZE - 1);
+    ring->hold = 1;
+    *count = ring->count[slot];
+    return &ring->blk[slot];
+}
+
+//------------------------------------//
+//          Reader Functions          //
+//------------------------------------//
+
+trace_t* trace_open(const char* path)
+{
+    trace_t* trace = (trace_t*)calloc(1, sizeof(trace_t));
+    trace->buf = (char*)malloc(TRACE_BUF_SIZE);
+
+    if (path == NULL)
+    {
+        trace->file = stdin;
+    }
+    else if ((trace->file = fopen(path, "rb")) == NULL)
+    {
+        perror(path);
+        trace_close(trace);
+        return NULL;
+    }
+
+    // Detect compression and format from the first bytes of the trace
+    fill_buffer(trace);
+    if (trace->buf_len >= 3 && memcmp(trace->buf, "BZh", 3) == 0)
+    {
+        start_inflate(trace);
+    }
+
+    if (trace->buf_len < sizeof(trace_header_t) ||
+        memcmp(trace->buf, TRACE_MAGIC, 8) != 0)
+    {
+        trace->format = TRACE_TEXT;
+    }
+    else
+    {
+        trace_header_t hdr;
+        read_bytes(trace, &hdr, sizeof(hdr));
+        if (!check_header(&hdr))
+        {
+            trace_close(trace);
+            return NULL;
+        }
+        trace->format = TRACE_BIN;
+        trace->num_branches = hdr.num_branches;
+        trace->remaining = hdr.num_branches;
+
+        // Uncompressed files are mapped so the blocks are read in place
+        if (path != NULL && !trace->compressed &&
+            map_trace(trace, fileno(trace->file)))
+        {
+            fclose(trace->file);
+            trace->file = NULL;
+            free(trace->buf);
+            trace->buf = NULL;
+            return trace;
+        }
+    }
+
+    // Decode the stream on a separate thread
+    trace->ring = (struct trace_ring*)aligned_alloc(
+        64, sizeof(struct trace_ring));
+    memset(trace->ring, 0, sizeof(struct trace_ring));
+    pthread_mutex_init(&trace->ring->lock, NULL);
+    pthread_cond_init(&trace->ring->wake, NULL);
+    if (pthread_create(&trace->ring->producer, NULL, producer_main, trace))
+    {
+        perror("pthread_create");
+        pthread_cond_destroy(&trace->ring->wake);
+        pthread_mutex_destroy(&trace->ring->lock);
+        free(trace->ring);
+        trace->ring = NULL;
+    }
+
+    return trace;
+}
+
+void trace_close(trace_t* trace)
+{
+    if (trace->ring)
+    {
+        __atomic_store_n(&trace->ring->stop, 1, __ATOMIC_RELEASE);
+        ring_signal(trace->ring);
+        pthread_join(trace->ring->producer, NULL);
+        pthread_cond_destroy(&trace->ring->wake);
+        pthread_mutex_destroy(&trace->ring->lock);
+        free(trace->ring);
+    }
+    if (trace->map)
+    {
+        munmap((void*)trace->map, trace->map_len);
+    }
+    if (trace->file && trace->file != stdin)
+    {
+        fclose(trace->file);
+    }
+    if (trace->bz)
+    {
+        BZ2_bzDecompressEnd((bz_stream*)trace->bz);
+        free(trace->bz);
+    }
+    free(trace->zbuf);
+    free(trace->buf);
+    free(trace);
+}
+
+const trace_block_t* trace_next_block(trace_t* trace, int* count)
+{
+    if (trace->map)
+    {
+        return next_mapped_block(trace, count);
+    }
+    if (trace->ring)
+    {
+        return next_ring_block(trace, count);
+    }
+
+    // single threaded fallback if the producer could not be started
+    static __thread trace_block_t scratch;
+    int n = trace->format == TRACE_BIN ? read_binary_block(trace, &scratch)
+                                       : read_text_block(trace, &scratch);
+    *count = n;
+    return n ? &scratch : NULL;
+}
+
+uint64_t trace_skip(trace_t* trace, uint64_t n)
+{
+    uint64_t done = 0;
+    while (done < n)
+    {
+        if (trace->blk_pos == trace->blk_count)
+        {
+            // jump over the full blocks of a mapped trace
+            uint64_t full = trace->num_branches / TRACE_BLOCK;
+            if (trace->map && trace->next_block < full)
+            {
+                uint64_t blocks = (n - done) / TRACE_BLOCK;
+                if (blocks > full - trace->next_block)
+                    blocks = full - trace->next_block;
+                trace->next_block += blocks;
+                done += blocks * TRACE_BLOCK;
+                if (done == n)
+                    break;
+            }
+
+            trace->blk = trace_next_block(trace, &trace->blk_count);
+            trace->blk_pos = 0;
+            if (trace->blk == NULL)
+            {
+                trace->blk_count = 0;
+                break;
+            }
+        }
+
+        uint64_t left = trace->blk_count - trace->blk_pos;
+        if (left > n - done)
+            left = n - done;
+        trace->blk_pos += (int)left;
+        done += left;
+    }
+    return done;
+}
+
+//------------------------------------//
+//         In-Memory Traces           //
+//------------------------------------//
+
+int trace_load(trace_mem_t* mem, const char* path)
+{
+    memset(mem, 0, sizeof(*mem));
+    trace_t* trace = trace_open(path);
+    if (trace == NULL)
+    {
+        return 0;
+    }
+
+    // A mapped trace already is an array of blocks
+    if (trace->map)
+    {
+        mem->trace = trace;
+        mem->blocks = trace->blocks;
+        mem->num_blocks = trace->num_blocks;
+        mem->num_branches = trace->num_branches;
+        return 1;
+    }
+
+    // the count in the header of a stream is only trusted so far
+    uint64_t cap = trace->num_branches ? trace->num_branches / TRACE_BLOCK + 1
+                                       : 1024;
+    if (cap > TRACE_LOAD_BLOCKS)
+    {
+        cap = TRACE_LOAD_BLOCKS;
+    }
+    trace_block_t* blocks = (trace_block_t*)malloc(cap * sizeof(trace_block_t));
+    const trace_block_t* blk;
+    int count;
+    while ((blk = trace_next_block(trace, &count)) != NULL)
+    {
+        if (mem->num_blocks == cap)
+        {
+            cap *= 2;
+            blocks = (trace_block_t*)realloc(blocks, cap * sizeof(*blocks));
+        }
+        blocks[mem->num_blocks++] = *blk;
+        mem->num_branches += count;
+    }
+    int error = trace->error;
+    trace_close(trace);
+    if (error)
+    {
+        free(blocks);
+        memset(mem, 0, sizeof(*mem));
+        return 0;
+    }
+
+    mem->owned = blocks;
+    mem->blocks = blocks;
+    return 1;
+}
+
+void trace_unload(trace_mem_t* mem)
+{
+    if (mem->trace)
+    {
+        trace_close(mem->trace);
+    }
+    free(mem->owned);
+    memset(mem, 0, sizeof(*mem));
+}
+
+//------------------------------------//
+//          Writer Functions          //
+//------------------------------------//
+
+static int write_header(trace_writer_t* writer, uint64_t num_branches)
+{
+    trace_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, TRACE_MAGIC, 8);
+    hdr.version = TRACE_VERSION;
+    hdr.blockSize = TRACE_BLOCK;
+    hdr.num_branches = num_branches;
+
+    return fwrite(&hdr, sizeof(hdr), 1, writer->file) == 1;
+}
+
+static int flush_block(trace_writer_t* writer)
+{
+    // zero the unused tail of a partial block so output is deterministic
+    for (int i = writer->blk_count; i < TRACE_BLOCK; i++)
+    {
+        writer->blk.pc[i] = 0;
+    }
+    int ok = fwrite(&writer->blk, sizeof(trace_block_t), 1, writer->file) == 1;
+    writer->blk.taken = 0;
+    writer->blk_count = 0;
+    return ok;
+}
+
+trace_writer_t* trace_writer_open(const char* path)
+{
+    trace_writer_t* writer = (trace_writer_t*)calloc(1, sizeof(trace_writer_t));
+    if ((writer->file = fopen(path, "wb")) == NULL ||
+        !write_header(writer, 0))
+    {
+        perror(path);
+        if (writer->file)
+            fclose(writer->file);
+        free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+trace_writer_t* trace_writer_stream(FILE* file, uint64_t num_branches)
+{
+    trace_writer_t* writer = (trace_writer_t*)calloc(1, sizeof(trace_writer_t));
+    writer->file = file;
+    writer->streamed = 1;
+    writer->expected = num_branches;
+    if (!write_header(writer, num_branches))
+    {
+        perror("trace output");
+        free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+int trace_write(trace_writer_t* writer, uint32_t pc, uint8_t outcome)
+{
+    writer->blk.pc[writer->blk_count] = pc;
+    writer->blk.taken |= (uint64_t)(outcome & 0x1) << writer->blk_count;
+    writer->num_branches++;
+
+    if (++writer->blk_count == TRACE_BLOCK)
+    {
+        return flush_block(writer);
+    }
+    return 1;
+}
+
+int trace_writer_close(trace_writer_t* writer)
+{
+    int ok = 1;
+    if (writer->blk_count > 0)
+    {
+        ok = flush_block(writer);
+    }
+
+    if (writer->streamed)
+    {
+        // the header already promised the branch count
+        ok = ok && writer->num_branches == writer->expected;
+        ok = (fflush(writer->file) == 0) && ok;
+        free(writer);
+        return ok;
+    }
+
+    // rewrite the header now that the branch count is known
+    ok = ok && fseek(writer->file, 0, SEEK_SET) == 0 &&
+         write_header(writer, writer->num_branches);
+    ok = (fclose(writer->file) == 0) && ok;
+    free(writer);
+    return ok;
+}
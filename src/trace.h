@@ -0,0 +1,222 @@
+//========================================================//
+//  trace.h                                               //
+//  Header file for the branch trace readers              //
+//                                                        //
+//  Traces are handed to the simulator in fixed size      //
+//  blocks of branches regardless of the file format      //
+//========================================================//
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+//------------------------------------//
+//         Trace Block Layout         //
+//------------------------------------//
+
+// Number of branches held in one block
+#define TRACE_BLOCK 64
+
+// A block holds the outcomes of up to TRACE_BLOCK branches as a bitmap
+// (bit i set means branch i was taken) followed by their PCs. The binary
+// trace format is a header followed by an array of these blocks, so a
+// mmap'ed trace can be walked in place.
+typedef struct
+{
+    uint64_t taken;
+    uint32_t pc[TRACE_BLOCK];
+} trace_block_t;
+
+//------------------------------------//
+//        Binary Trace Format         //
+//------------------------------------//
+
+#define TRACE_MAGIC   "BPTRACE\0"
+#define TRACE_VERSION 1
+
+// Header of a binary trace. The header and the blocks are stored in the
+// byte order of the host that wrote them and read back without
+// conversion, so a trace only moves between hosts of the same order.
+// The header is 64 bytes, which aligns the first block to a cache line;
+// the blocks themselves are 264 bytes and packed back to back. The last
+// block is partial when num_branches is not a multiple of TRACE_BLOCK.
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t blockSize;    // branches per block, TRACE_BLOCK
+    uint64_t num_branches; // total branches in the trace
+    uint8_t reserved[40];
+} trace_header_t;
+
+//------------------------------------//
+//            Trace Reader            //
+//------------------------------------//
+
+// The different trace formats
+#define TRACE_TEXT 0 // one "0x<pc> <outcome>" line per branch
+#define TRACE_BIN  1 // packed binary blocks
+extern const char* traceFormatName[];
+
+typedef struct
+{
+    int format;
+
+    // Block currently being walked by trace_read()
+    const trace_block_t* blk;
+    int blk_count;
+    int blk_pos;
+
+    // Binary traces opened from a file are mmap'ed
+    const uint8_t* map;
+    size_t map_len;
+    const trace_block_t* blocks;
+    uint64_t num_blocks;
+    uint64_t next_block;
+    uint64_t num_branches; // from the header, 0 when unknown
+
+    // Everything else is streamed through a read buffer, decompressing
+    // bzip2 input on the way. A producer thread fills a ring of blocks
+    // from the stream while the simulator drains it.
+    FILE* file;
+    char* buf;
+    size_t buf_len;
+    size_t buf_pos;
+    int eof;
+    int error; // the input was truncated or corrupt
+    int compressed;
+    void* bz;   // bz_stream when compressed
+    char* zbuf; // compressed input
+    uint64_t remaining; // branches left in a streamed binary trace
+    struct trace_ring* ring;
+} trace_t;
+
+// Open the trace at 'path', or stdin when 'path' is NULL. The format and
+// bzip2 compression are detected from the contents of the file.
+//
+// Returns NULL on failure
+//
+trace_t* trace_open(const char* path);
+
+// Close the trace and release any mapping or buffers
+//
+void trace_close(trace_t* trace);
+
+// Get the next block of branches from the trace, storing the number of
+// valid branches in 'count'. The block stays valid until the next call.
+//
+// Returns NULL at the end of the trace, with 'error' set if the trace
+// was cut short or could not be decoded
+//
+const trace_block_t* trace_next_block(trace_t* trace, int* count);
+
+// Reads the next branch from the trace
+//
+// Returns True if Successful
+//
+static inline int trace_read(trace_t* trace, uint32_t* pc, uint8_t* outcome)
+{
+    if (trace->blk_pos == trace->blk_count)
+    {
+        trace->blk = trace_next_block(trace, &trace->blk_count);
+        trace->blk_pos = 0;
+        if (trace->blk == NULL)
+        {
+            trace->blk_count = 0;
+            return 0;
+        }
+    }
+
+    *pc = trace->blk->pc[trace->blk_pos];
+    *outcome = (trace->blk->taken >> trace->blk_pos) & 0x1;
+    trace->blk_pos++;
+
+    return 1;
+}
+
+// Skip the next 'n' branches of the trace without decoding them where the
+// format allows, jumping over whole blocks of mapped traces
+//
+// Returns the number of branches skipped, less than 'n' at the end
+//
+uint64_t trace_skip(trace_t* trace, uint64_t n);
+
+//------------------------------------//
+//          In-Memory Traces          //
+//------------------------------------//
+
+// A whole trace held in memory, shared read-only by any number of
+// simulations. Every block but the last is full.
+typedef struct
+{
+    const trace_block_t* blocks;
+    uint64_t num_blocks;
+    uint64_t num_branches;
+
+    trace_t* trace;       // mapped binary trace backing 'blocks'
+    trace_block_t* owned; // decoded copy of any other trace
+} trace_mem_t;
+
+// Load the trace at 'path' (stdin when NULL) into 'mem'. Binary trace
+// files are used in place, other traces are decoded into memory.
+//
+// Returns True if Successful
+//
+int trace_load(trace_mem_t* mem, const char* path);
+
+// Release a loaded trace
+//
+void trace_unload(trace_mem_t* mem);
+
+// Get the number of valid branches in block 'b' of a loaded trace
+//
+static inline int trace_mem_count(const trace_mem_t* mem, uint64_t b)
+{
+    uint64_t left = mem->num_branches - b * TRACE_BLOCK;
+    return left < TRACE_BLOCK ? (int)left : TRACE_BLOCK;
+}
+
+//------------------------------------//
+//            Trace Writer            //
+//------------------------------------//
+
+typedef struct
+{
+    FILE* file;
+    uint64_t num_branches;
+    trace_block_t blk;
+    int blk_count;
+    int streamed;      // header written up front, the file is not ours
+    uint64_t expected; // branches announced in the header of a stream
+} trace_writer_t;
+
+// Create a binary trace at 'path'. The file must be seekable since the
+// header is rewritten with the final branch count on close.
+//
+// Returns NULL on failure
+//
+trace_writer_t* trace_writer_open(const char* path);
+
+// Write a binary trace of exactly 'num_branches' branches to 'file', for
+// output that cannot seek such as a pipe. The header is written first
+// and the file is left open on close.
+//
+// Returns NULL on failure
+//
+trace_writer_t* trace_writer_stream(FILE* file, uint64_t num_branches);
+
+// Append a branch to the trace
+//
+// Returns True if Successful
+//
+int trace_write(trace_writer_t* writer, uint32_t pc, uint8_t outcome);
+
+// Flush the last block, finalize the header and close the file
+//
+// Returns True if Successful
+//
+int trace_writer_close(trace_writer_t* writer);
+
+#endif
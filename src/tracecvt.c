@@ -0,0 +1,84 @@
+//========================================================//
+//  tracecvt.c                                            //
+//  Trace converter for the Branch Predictor              //
+//                                                        //
+//  Converts text traces into the packed binary format    //
+//  read by predictor                                     //
+//========================================================//
+
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Print out the Usage information to stderr
+//
+void usage()
+{
+    fprintf(stderr, "Usage: tracecvt [<trace>] <output>\n");
+    fprintf(stderr, "       tracecvt trace.bz2 <output>\n");
+    fprintf(stderr, "       bunzip2 -kc trace.bz2 | tracecvt <output>\n");
+    fprintf(stderr, " Converts a trace into the packed binary format\n");
+}
+
+int main(int argc, char* argv[])
+{
+    const char* in_path = NULL;
+    const char* out_path = NULL;
+
+    if (argc == 2 && strcmp(argv[1], "--help") != 0)
+    {
+        out_path = argv[1];
+    }
+    else if (argc == 3)
+    {
+        in_path = argv[1];
+        out_path = argv[2];
+    }
+    else
+    {
+        usage();
+        exit(argc == 2 ? 0 : 1);
+    }
+
+    trace_t* trace = trace_open(in_path);
+    if (trace == NULL)
+    {
+        exit(1);
+    }
+
+    trace_writer_t* writer = trace_writer_open(out_path);
+    if (writer == NULL)
+    {
+        trace_close(trace);
+        exit(1);
+    }
+
+    uint32_t pc;
+    uint8_t outcome;
+    int ok = 1;
+    while (ok && trace_read(trace, &pc, &outcome))
+    {
+        ok = trace_write(writer, pc, outcome);
+    }
+
+    uint64_t num_branches = writer->num_branches;
+    ok = trace_writer_close(writer) && ok;
+    int error = trace->error;
+    trace_close(trace);
+
+    if (error)
+    {
+        fprintf(stderr, "Failed reading %s\n", in_path ? in_path : "stdin");
+        exit(1);
+    }
+    if (!ok)
+    {
+        fprintf(stderr, "Failed writing %s\n", out_path);
+        exit(1);
+    }
+    fprintf(stderr, "Wrote %llu branches to %s\n",
+            (unsigned long long)num_branches, out_path);
+
+    return 0;
+}
@@ -0,0 +1,251 @@
+//========================================================//
+//  tracegen.c                                            //
+//  Synthetic trace generator for the Branch Predictor    //
+//                                                        //
+//  Generates traces of any length from a random program  //
+//  of biased, loop, correlated and patterned branches    //
+//========================================================//
+
+#include "trace.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Behaviours of the static branches
+#define GEN_BIASED     0 // taken with a fixed probability
+#define GEN_LOOP       1 // jumps back a - 1 times, then falls through
+#define GEN_CORRELATED 2 // xor of two earlier global outcomes
+#define GEN_PATTERN    3 // repeats a fixed pattern of outcomes
+#define GEN_RANDOM     4 // taken half of the time
+
+// Addresses of the generated program
+#define GEN_BASE_PC 0x400000
+
+typedef struct
+{
+    uint32_t pc;
+    uint8_t type;
+    uint32_t a;     // bias threshold, trip count, distance or pattern
+    uint32_t b;     // second distance or pattern length
+    uint32_t count; // position in the loop or pattern
+    uint32_t skip;  // branches jumped over when taken, or back for loops
+} gen_branch_t;
+
+static uint64_t seed = 1;
+
+// xorshift64*
+//
+static inline uint64_t gen_random()
+{
+    seed ^= seed >> 12;
+    seed ^= seed << 25;
+    seed ^= seed >> 27;
+    return seed * 0x2545f4914f6cdd1dULL;
+}
+
+// Print out the Usage information to stderr
+//
+void usage()
+{
+    fprintf(stderr, "Usage: tracegen <options> <output>\n");
+    fprintf(stderr, " Writes a synthetic binary trace to output, or to stdout\n"
+                    " when output is -, e.g.\n"
+                    "   tracegen --branches 5000000000 - | predictor\n");
+    fprintf(stderr, " Options:\n");
+    fprintf(stderr, " --help            Print this message\n");
+    fprintf(stderr, " --branches <n>    Number of branches\n"
+                    "                   (default: 10000000)\n");
+    fprintf(stderr, " --static <n>      Number of static branches\n"
+                    "                   (default: 4096)\n");
+    fprintf(stderr, " --seed <n>        Random seed (default: 1)\n");
+    fprintf(stderr, " --text            Write the text format instead\n");
+}
+
+// Build a random program of 'num_static' branches
+//
+static gen_branch_t* make_program(uint32_t num_static)
+{
+    gen_branch_t* prog = (gen_branch_t*)calloc(num_static, sizeof(*prog));
+    for (uint32_t i = 0; i < num_static; i++)
+    {
+        gen_branch_t* br = &prog[i];
+        uint32_t mix = gen_random() % 100;
+
+        br->pc = GEN_BASE_PC + 16 * i + (gen_random() % 4) * 2;
+        br->skip = gen_random() % 8;
+        if (mix < 40)
+        {
+            // strongly biased either way
+            br->type = GEN_BIASED;
+            uint32_t bias = 90 + gen_random() % 10;
+            br->a = (uint32_t)((gen_random() & 1 ? bias : 100 - bias) *
+                               (UINT32_MAX / 100));
+        }
+        else if (mix < 65)
+        {
+            br->type = GEN_LOOP;
+            br->a = 2 + gen_random() % 63;
+        }
+        else if (mix < 85)
+        {
+            br->type = GEN_CORRELATED;
+            br->a = 1 + gen_random() % 24;
+            br->b = 1 + gen_random() % 24;
+        }
+        else if (mix < 95)
+        {
+            br->type = GEN_PATTERN;
+            br->b = 2 + gen_random() % 15;
+            br->a = (uint32_t)gen_random();
+        }
+        else
+        {
+            br->type = GEN_RANDOM;
+        }
+    }
+    return prog;
+}
+
+// Get the next outcome of 'br', given the global history 'ghist'
+//
+static inline uint8_t run_branch(gen_branch_t* br, uint64_t ghist)
+{
+    uint8_t outcome;
+    switch (br->type)
+    {
+    case GEN_BIASED:
+        return (uint32_t)gen_random() < br->a;
+    case GEN_LOOP:
+        outcome = ++br->count < br->a;
+        if (!outcome)
+            br->count = 0;
+        return outcome;
+    case GEN_CORRELATED:
+        outcome = ((ghist >> br->a) ^ (ghist >> br->b)) & 0x1;
+        // a little noise
+        return (gen_random() % 50) == 0 ? !outcome : outcome;
+    case GEN_PATTERN:
+        outcome = (br->a >> br->count) & 0x1;
+        br->count = (br->count + 1) % br->b;
+        return outcome;
+    default:
+        return gen_random() & 0x1;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    uint64_t num_branches = 10000000;
+    uint32_t num_static = 4096;
+    int text = 0;
+    const char* out_path = NULL;
+
+    // Process cmdline Arguments
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--help"))
+        {
+            usage();
+            exit(0);
+        }
+        else if (!strcmp(argv[i], "--branches") && i + 1 < argc)
+        {
+            num_branches = strtoull(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--static") && i + 1 < argc)
+        {
+            num_static = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+        {
+            seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--text"))
+        {
+            text = 1;
+        }
+        else if (!strncmp(argv[i], "--", 2) || out_path != NULL)
+        {
+            printf("Unrecognized option %s\n", argv[i]);
+            usage();
+            exit(1);
+        }
+        else
+        {
+            out_path = argv[i];
+        }
+    }
+
+    if (out_path == NULL || num_static == 0)
+    {
+        usage();
+        exit(1);
+    }
+    // xorshift never leaves 0
+    seed = seed ? seed : 1;
+
+    int to_stdout = !strcmp(out_path, "-");
+    FILE* file = NULL;
+    trace_writer_t* writer = NULL;
+    if (text)
+    {
+        file = to_stdout ? stdout : fopen(out_path, "w");
+        if (file == NULL)
+        {
+            perror(out_path);
+            exit(1);
+        }
+    }
+    else
+    {
+        writer = to_stdout ? trace_writer_stream(stdout, num_branches)
+                           : trace_writer_open(out_path);
+        if (writer == NULL)
+        {
+            exit(1);
+        }
+    }
+
+    gen_branch_t* prog = make_program(num_static);
+    uint64_t ghist = 0;
+    uint32_t idx = 0;
+    int ok = 1;
+
+    for (uint64_t n = 0; ok && n < num_branches; n++)
+    {
+        gen_branch_t* br = &prog[idx];
+        uint8_t outcome = run_branch(br, ghist);
+        ghist = (ghist << 1) | outcome;
+
+        if (text)
+            ok = fprintf(file, "0x%x %d\n", br->pc, outcome) > 0;
+        else
+            ok = trace_write(writer, br->pc, outcome);
+
+        // fall through to the next branch, or jump over a few, or back
+        // to the start of a loop
+        if (outcome && br->type == GEN_LOOP)
+            idx = (idx + num_static - br->skip % num_static) % num_static;
+        else
+            idx = (idx + 1 + (outcome ? br->skip : 0)) % num_static;
+    }
+
+    if (text)
+        ok = (to_stdout ? fflush(file) : fclose(file)) == 0 && ok;
+    else
+        ok = trace_writer_close(writer) && ok;
+    free(prog);
+
+    if (!ok)
+    {
+        fprintf(stderr, "Failed writing %s\n", out_path);
+        exit(1);
+    }
+    if (!to_stdout)
+    {
+        fprintf(stderr, "Wrote %" PRIu64 " branches to %s\n", num_branches,
+                out_path);
+    }
+    return 0;
+}
@@ -0,0 +1,662 @@
+//========================================================//
+//  tracestats.c                                          //
+//  Trace characterization tool for the Branch Predictor  //
+//                                                        //
+//  Profiles the bias, entropy and working set of traces  //
+//  in one streaming pass, one window per pool job        //
+//========================================================//
+
+#include "pool.h"
+#include "trace.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Defaults, in branches
+#define STATS_WINDOW  (1 << 20)
+#define STATS_WARMUP  (1 << 16)
+#define STATS_HISTORY 16
+
+// Contexts counted for the history entropies are hashed into tables of
+// 1 << bits entries
+#define STATS_CONTEXT_BITS     18
+#define STATS_MAX_CONTEXT_BITS 24
+
+// Static branches in the map of a new job
+#define STATS_MAP_INITIAL 1024
+
+// Buckets of the taken rate: never, tenths of the rate, always
+#define NUM_BIAS_BUCKETS 12
+static const char* biasName[NUM_BIAS_BUCKETS] = {
+    "never",  "0-10%",  "10-20%", "20-30%", "30-40%",  "40-50%",
+    "50-60%", "60-70%", "70-80%", "80-90%", "90-100%", "always"};
+
+// A static branch
+typedef struct
+{
+    uint64_t key; // pc with bit 32 set, 0 when the slot is free
+    uint64_t executions;
+    uint64_t taken;
+    uint64_t chunk;  // 1 + the chunk that 'lhist' belongs to
+    uint64_t window; // 1 + the last window the branch was counted in
+    uint32_t lhist;
+} stats_branch_t;
+
+// Open-addressing hash map of the static branches
+typedef struct
+{
+    stats_branch_t* slots;
+    uint64_t capacity; // power of two
+    uint64_t size;
+} stats_map_t;
+
+// Counters of one job, and of the whole trace once merged
+typedef struct
+{
+    stats_map_t branches;
+    uint64_t* global; // not taken and taken per pc and global history
+    uint64_t* local;  // not taken and taken per pc and local history
+} stats_acc_t;
+
+// The branches counted in one window of the trace
+typedef struct
+{
+    uint64_t branches;
+    uint64_t taken;
+    uint64_t pcs; // working set, the distinct branches
+} stats_window_t;
+
+// A chunk of the trace: the last branches of the previous chunk, which
+// only warm up the histories, followed by the branches of one window
+typedef struct
+{
+    trace_block_t* blocks;
+    uint64_t warm;
+    uint64_t num_branches; // warm-up and window
+    uint64_t window;
+} stats_chunk_t;
+
+typedef struct
+{
+    stats_chunk_t* chunks; // one per job of a round
+    stats_acc_t* accs;     // one per job of a round
+    stats_window_t* windows;
+    int history;
+    int context_bits;
+} stats_t;
+
+// Print out the Usage information to stderr
+//
+void usage()
+{
+    fprintf(stderr, "Usage: tracestats <options> [<trace> ...]\n");
+    fprintf(stderr, " Prints the branch counts, taken bias, history entropy\n"
+                    " and working set of each trace, or of stdin\n");
+    fprintf(stderr, " Options:\n");
+    fprintf(stderr, " --help            Print this message\n");
+    fprintf(stderr, " --window <n>      Branches per window of the working\n"
+                    "                   set (default: 1048576)\n");
+    fprintf(stderr, " --warmup <n>      Branches before each window that\n"
+                    "                   warm up its histories\n"
+                    "                   (default: 65536)\n");
+    fprintf(stderr, " --history <n>     Bits of global and local history\n"
+                    "                   for the entropies (default: 16)\n");
+    fprintf(stderr, " --context-bits <n>\n"
+                    "                   Log2 of the entries counting the\n"
+                    "                   history contexts (default: 18)\n");
+    fprintf(stderr, " --window-csv <file>\n"
+                    "                   Write the counts of every window\n"
+                    "                   as CSV\n");
+    fprintf(stderr, " --threads <n>     Threads (default: cores)\n");
+}
+
+//------------------------------------//
+//            Branch Map              //
+//------------------------------------//
+
+static inline uint64_t hash_pc(uint32_t pc)
+{
+    uint64_t h = pc * 0x9e3779b97f4a7c15ULL;
+    return h ^ (h >> 32);
+}
+
+static void map_init(stats_map_t* map)
+{
+    map->capacity = STATS_MAP_INITIAL;
+    map->size = 0;
+    map->slots = (stats_branch_t*)calloc(map->capacity, sizeof(*map->slots));
+}
+
+// Double the capacity of 'map'
+//
+static void map_grow(stats_map_t* map)
+{
+    stats_branch_t* old = map->slots;
+    uint64_t old_capacity = map->capacity;
+    map->capacity *= 2;
+    map->slots = (stats_branch_t*)calloc(map->capacity, sizeof(*map->slots));
+
+    uint64_t mask = map->capacity - 1;
+    for (uint64_t s = 0; s < old_capacity; s++)
+    {
+        if (old[s].key == 0)
+            continue;
+        uint64_t slot = hash_pc((uint32_t)old[s].key) & mask;
+        while (map->slots[slot].key != 0)
+            slot = (slot + 1) & mask;
+        map->slots[slot] = old[s];
+    }
+    free(old);
+}
+
+// Get the branch at 'pc', adding it when it is new
+//
+static stats_branch_t* map_get(stats_map_t* map, uint32_t pc)
+{
+    uint64_t key = (1ULL << 32) | pc;
+    uint64_t mask = map->capacity - 1;
+    uint64_t slot = hash_pc(pc) & mask;
+    while (map->slots[slot].key != key)
+    {
+        if (map->slots[slot].key == 0)
+        {
+            // keep the map at most half full
+            if (++map->size * 2 > map->capacity)
+            {
+                map_grow(map);
+                return map_get(map, pc);
+            }
+            map->slots[slot].key = key;
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return &map->slots[slot];
+}
+
+//------------------------------------//
+//             Counting               //
+//------------------------------------//
+
+// Get the entry counting the context of the branch at 'pc' with the
+// history 'hist'
+//
+static inline uint64_t context_index(uint32_t pc, uint32_t hist, int bits)
+{
+    uint64_t h = (((uint64_t)pc << 32) | hist) * 0x9e3779b97f4a7c15ULL;
+    return h >> (64 - bits);
+}
+
+static void acc_init(stats_acc_t* acc, int context_bits)
+{
+    map_init(&acc->branches);
+    acc->global = (uint64_t*)calloc(2ULL << context_bits, sizeof(uint64_t));
+    acc->local = (uint64_t*)calloc(2ULL << context_bits, sizeof(uint64_t));
+}
+
+static void acc_free(stats_acc_t* acc)
+{
+    free(acc->branches.slots);
+    free(acc->global);
+    free(acc->local);
+}
+
+// Add the counters of 'from' to 'to'
+//
+static void acc_merge(stats_acc_t* to, const stats_acc_t* from,
+                      int context_bits)
+{
+    for (uint64_t s = 0; s < from->branches.capacity; s++)
+    {
+        const stats_branch_t* br = &from->branches.slots[s];
+        if (br->executions == 0)
+            continue;
+        stats_branch_t* sum = map_get(&to->branches, (uint32_t)br->key);
+        sum->executions += br->executions;
+        sum->taken += br->taken;
+    }
+    for (uint64_t e = 0; e < (2ULL << context_bits); e++)
+    {
+        to->global[e] += from->global[e];
+        to->local[e] += from->local[e];
+    }
+}
+
+// Count the branches of one chunk into the counters of the job
+//
+static void stats_job(void* arg, int job)
+{
+    stats_t* st = (stats_t*)arg;
+    const stats_chunk_t* c = &st->chunks[job];
+    stats_acc_t* acc = &st->accs[job];
+    stats_window_t* w = &st->windows[c->window];
+    uint64_t id = c->window + 1;
+    uint32_t mask = (uint32_t)((1ULL << st->history) - 1);
+    int bits = st->context_bits;
+
+    // the histories of the first chunk start cold, as in a simulation,
+    // the others are rebuilt by the warm-up
+    uint32_t ghist = 0;
+    for (uint64_t n = 0; n < c->num_branches; n++)
+    {
+        const trace_block_t* blk = &c->blocks[n / TRACE_BLOCK];
+        int i = n % TRACE_BLOCK;
+        uint32_t pc = blk->pc[i];
+        uint8_t outcome = (blk->taken >> i) & 0x1;
+
+        stats_branch_t* br = map_get(&acc->branches, pc);
+        if (br->chunk != id)
+        {
+            br->chunk = id;
+            br->lhist = 0;
+        }
+        if (n >= c->warm)
+        {
+            br->executions++;
+            br->taken += outcome;
+            if (br->window != id)
+            {
+                br->window = id;
+                w->pcs++;
+            }
+            w->taken += outcome;
+            acc->global[2 * context_index(pc, ghist, bits) + outcome]++;
+            acc->local[2 * context_index(pc, br->lhist, bits) + outcome]++;
+        }
+        ghist = ((ghist << 1) | outcome) & mask;
+        br->lhist = ((br->lhist << 1) | outcome) & mask;
+    }
+    w->branches = c->num_branches - c->warm;
+}
+
+// Read up to 'max' branches from 'trace' into 'blocks', copying whole
+// blocks where the trace hands them out
+//
+// Returns the number of branches read
+//
+static uint64_t read_branches(trace_t* trace, trace_block_t* blocks,
+                              uint64_t max)
+{
+    uint64_t n = 0;
+    while (n < max)
+    {
+        if (trace->blk_pos == trace->blk_count && n % TRACE_BLOCK == 0 &&
+            max - n >= TRACE_BLOCK)
+        {
+            int count;
+            const trace_block_t* blk = trace_next_block(trace, &count);
+            if (blk == NULL)
+                break;
+            if (count == TRACE_BLOCK)
+            {
+                blocks[n / TRACE_BLOCK] = *blk;
+                n += TRACE_BLOCK;
+                continue;
+            }
+            // a partial block is read branch by branch
+            trace->blk = blk;
+            trace->blk_count = count;
+            trace->blk_pos = 0;
+        }
+
+        uint32_t pc;
+        uint8_t outcome;
+        if (!trace_read(trace, &pc, &outcome))
+            break;
+        trace_block_t* blk = &blocks[n / TRACE_BLOCK];
+        int i = n % TRACE_BLOCK;
+        if (i == 0)
+            blk->taken = 0;
+        blk->pc[i] = pc;
+        blk->taken |= (uint64_t)outcome << i;
+        n++;
+    }
+    return n;
+}
+
+//------------------------------------//
+//             Reporting              //
+//------------------------------------//
+
+// Get the entropy in bits of an outcome taken with probability 'p'
+//
+static double entropy(double p)
+{
+    if (p <= 0.0 || p >= 1.0)
+        return 0.0;
+    return -p * log2(p) - (1.0 - p) * log2(1.0 - p);
+}
+
+// Get the entropy of the outcome given the contexts counted in 'counts'
+//
+static double context_entropy(const uint64_t* counts, int bits,
+                              uint64_t num_branches)
+{
+    double sum = 0.0;
+    for (uint64_t e = 0; e < (1ULL << bits); e++)
+    {
+        uint64_t n = counts[2 * e] + counts[2 * e + 1];
+        if (n > 0)
+            sum += n * entropy((double)counts[2 * e + 1] / n);
+    }
+    return num_branches ? sum / num_branches : 0.0;
+}
+
+static int compare_executions(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x < y) - (x > y);
+}
+
+static void report(const char* name, const stats_acc_t* total,
+                   const stats_window_t* windows, uint64_t num_windows,
+                   uint64_t window, int history, int context_bits)
+{
+    uint64_t num_branches = 0, taken = 0;
+    for (uint64_t w = 0; w < num_windows; w++)
+    {
+        num_branches += windows[w].branches;
+        taken += windows[w].taken;
+    }
+
+    // Per static branch
+    const stats_map_t* map = &total->branches;
+    uint64_t* executions =
+        (uint64_t*)malloc((map->size + 1) * sizeof(uint64_t));
+    uint64_t num_static = 0, static_bucket[NUM_BIAS_BUCKETS] = {0},
+             dynamic_bucket[NUM_BIAS_BUCKETS] = {0};
+    double pc_entropy = 0.0;
+    for (uint64_t s = 0; s < map->capacity; s++)
+    {
+        const stats_branch_t* br = &map->slots[s];
+        if (br->executions == 0)
+            continue;
+        executions[num_static++] = br->executions;
+        pc_entropy +=
+            br->executions * entropy((double)br->taken / br->executions);
+
+        int bucket;
+        if (br->taken == 0)
+            bucket = 0;
+        else if (br->taken == br->executions)
+            bucket = NUM_BIAS_BUCKETS - 1;
+        else
+            bucket = 1 + (int)(10 * br->taken / br->executions);
+        static_bucket[bucket]++;
+        dynamic_bucket[bucket] += br->executions;
+    }
+
+    printf("Trace: %s\n", name);
+    printf("%-28s %12llu\n", "Branches",
+           (unsigned long long)num_branches);
+    printf("%-28s %12.3f\n", "Taken %",
+           num_branches ? 100.0 * taken / num_branches : 0.0);
+    printf("%-28s %12llu\n", "Static branches",
+           (unsigned long long)num_static);
+
+    // The fewest static branches making up a share of the executions
+    qsort(executions, num_static, sizeof(uint64_t), compare_executions);
+    const int share[3] = {50, 90, 99};
+    uint64_t covered = 0, hot = 0;
+    char label[32];
+    for (int k = 0; k < 3; k++)
+    {
+        while (hot < num_static && covered * 100 < num_branches * share[k])
+            covered += executions[hot++];
+        snprintf(label, sizeof(label), "Static covering %d%%", share[k]);
+        printf("%-28s %12llu\n", label, (unsigned long long)hot);
+    }
+    free(executions);
+
+    printf("\nEntropy of the outcome, bits per branch\n");
+    printf("%-28s %12.4f\n", "Unconditional",
+           num_branches ? entropy((double)taken / num_branches) : 0.0);
+    printf("%-28s %12.4f\n", "Given the PC",
+           num_branches ? pc_entropy / num_branches : 0.0);
+    snprintf(label, sizeof(label), "Given PC, %d global", history);
+    printf("%-28s %12.4f\n", label,
+           context_entropy(total->global, context_bits, num_branches));
+    snprintf(label, sizeof(label), "Given PC, %d local", history);
+    printf("%-28s %12.4f\n", label,
+           context_entropy(total->local, context_bits, num_branches));
+
+    printf("\n%-12s %12s %9s %9s\n", "Taken rate", "Static", "Static %",
+           "Dynamic %");
+    for (int b = 0; b < NUM_BIAS_BUCKETS; b++)
+    {
+        printf("%-12s %12llu %9.3f %9.3f\n", biasName[b],
+               (unsigned long long)static_bucket[b],
+               num_static ? 100.0 * static_bucket[b] / num_static : 0.0,
+               num_branches ? 100.0 * dynamic_bucket[b] / num_branches
+                            : 0.0);
+    }
+
+    // The last window is left out when it is partial and not alone
+    uint64_t full = num_windows;
+    if (full > 1 && windows[full - 1].branches < window)
+        full--;
+    uint64_t min = UINT64_MAX, max = 0, sum = 0;
+    for (uint64_t w = 0; w < full; w++)
+    {
+        min = windows[w].pcs < min ? windows[w].pcs : min;
+        max = windows[w].pcs > max ? windows[w].pcs : max;
+        sum += windows[w].pcs;
+    }
+    printf("\nWorking set per window of %llu branches\n",
+           (unsigned long long)window);
+    printf("%-12s %12s %12s %12s\n", "Windows", "Min", "Mean", "Max");
+    printf("%-12llu %12llu %12.1f %12llu\n\n", (unsigned long long)full,
+           (unsigned long long)(full ? min : 0),
+           full ? (double)sum / full : 0.0, (unsigned long long)max);
+}
+
+// Profile the trace at 'path', stdin when NULL, and print its report.
+// The trace is read in rounds of one chunk per thread, each counted by
+// a job of the pool into its own counters, which are merged at the end.
+// Memory is bounded by the chunks and counters, whatever the length.
+//
+// Returns True if Successful
+//
+static int profile_trace(const char* path, uint64_t window, uint64_t warmup,
+                         int history, int context_bits, int num_threads,
+                         FILE* csv)
+{
+    trace_t* trace = trace_open(path);
+    if (trace == NULL)
+    {
+        return 0;
+    }
+
+    stats_t st;
+    st.history = history;
+    st.context_bits = context_bits;
+    st.chunks = (stats_chunk_t*)calloc(num_threads, sizeof(stats_chunk_t));
+    st.accs = (stats_acc_t*)calloc(num_threads, sizeof(stats_acc_t));
+    for (int j = 0; j < num_threads; j++)
+    {
+        st.chunks[j].blocks = (trace_block_t*)malloc(
+            (warmup + window) / TRACE_BLOCK * sizeof(trace_block_t));
+        acc_init(&st.accs[j], context_bits);
+    }
+    uint64_t num_windows = 0, max_windows = 64;
+    st.windows = (stats_window_t*)malloc(max_windows * sizeof(*st.windows));
+
+    const stats_chunk_t* prev = NULL;
+    int more = 1;
+    while (more)
+    {
+        int jobs = 0;
+        while (more && jobs < num_threads)
+        {
+            stats_chunk_t* c = &st.chunks[jobs];
+
+            // warm up on the end of the previous chunk, which is still
+            // whole even when it is this one
+            uint64_t warm = 0;
+            if (prev != NULL)
+            {
+                warm = prev->num_branches < warmup ? prev->num_branches
+                                                   : warmup;
+                memmove(c->blocks,
+                        prev->blocks +
+                            (prev->num_branches - warm) / TRACE_BLOCK,
+                        warm / TRACE_BLOCK * sizeof(trace_block_t));
+            }
+            uint64_t n =
+                read_branches(trace, c->blocks + warm / TRACE_BLOCK, window);
+            more = n == window;
+            if (n == 0)
+                break;
+
+            if (num_windows == max_windows)
+            {
+                max_windows *= 2;
+                st.windows = (stats_window_t*)realloc(
+                    st.windows, max_windows * sizeof(*st.windows));
+            }
+            memset(&st.windows[num_windows], 0, sizeof(stats_window_t));
+            c->warm = warm;
+            c->num_branches = warm + n;
+            c->window = num_windows++;
+            prev = c;
+            jobs++;
+        }
+        pool_run(jobs, num_threads, stats_job, &st);
+    }
+    int error = trace->error;
+    trace_close(trace);
+
+    stats_acc_t total;
+    acc_init(&total, context_bits);
+    for (int j = 0; j < num_threads; j++)
+    {
+        acc_merge(&total, &st.accs[j], context_bits);
+        acc_free(&st.accs[j]);
+        free(st.chunks[j].blocks);
+    }
+
+    // a partial trace is not reported
+    if (error)
+    {
+        acc_free(&total);
+        free(st.windows);
+        free(st.chunks);
+        free(st.accs);
+        return 0;
+    }
+
+    const char* name = path ? path : "stdin";
+    report(name, &total, st.windows, num_windows, window, history,
+           context_bits);
+    for (uint64_t w = 0; csv != NULL && w < num_windows; w++)
+    {
+        fprintf(csv, "%s,%llu,%llu,%llu,%llu,%llu\n", name,
+                (unsigned long long)w, (unsigned long long)(w * window),
+                (unsigned long long)st.windows[w].branches,
+                (unsigned long long)st.windows[w].taken,
+                (unsigned long long)st.windows[w].pcs);
+    }
+
+    acc_free(&total);
+    free(st.windows);
+    free(st.chunks);
+    free(st.accs);
+    return 1;
+}
+
+int main(int argc, char* argv[])
+{
+    uint64_t window = STATS_WINDOW;
+    uint64_t warmup = STATS_WARMUP;
+    int history = STATS_HISTORY;
+    int context_bits = STATS_CONTEXT_BITS;
+    int num_threads = 0;
+    const char* csv_path = NULL;
+    const char** paths = (const char**)calloc(argc, sizeof(char*));
+    int num_paths = 0;
+
+    // Process cmdline Arguments
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--help"))
+        {
+            usage();
+            exit(0);
+        }
+        else if (!strcmp(argv[i], "--window") && i + 1 < argc)
+        {
+            window = strtoull(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--warmup") && i + 1 < argc)
+        {
+            warmup = strtoull(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--history") && i + 1 < argc)
+        {
+            history = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--context-bits") && i + 1 < argc)
+        {
+            context_bits = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--window-csv") && i + 1 < argc)
+        {
+            csv_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+        {
+            num_threads = atoi(argv[++i]);
+        }
+        else if (!strncmp(argv[i], "--", 2))
+        {
+            printf("Unrecognized option %s\n", argv[i]);
+            usage();
+            exit(1);
+        }
+        else
+        {
+            paths[num_paths++] = argv[i];
+        }
+    }
+
+    if (window == 0 || history < 1 || history > 32 || context_bits < 1 ||
+        context_bits > STATS_MAX_CONTEXT_BITS)
+    {
+        usage();
+        exit(1);
+    }
+    // chunks are whole blocks
+    window = (window + TRACE_BLOCK - 1) / TRACE_BLOCK * TRACE_BLOCK;
+    warmup = (warmup + TRACE_BLOCK - 1) / TRACE_BLOCK * TRACE_BLOCK;
+    if (num_threads <= 0)
+    {
+        num_threads = pool_default_threads();
+    }
+
+    FILE* csv = NULL;
+    if (csv_path != NULL)
+    {
+        if ((csv = fopen(csv_path, "w")) == NULL)
+        {
+            perror(csv_path);
+            exit(1);
+        }
+        fprintf(csv, "trace,window,first,branches,taken,working_set\n");
+    }
+
+    int ok = 1;
+    for (int t = 0; ok && t < (num_paths ? num_paths : 1); t++)
+    {
+        ok = profile_trace(num_paths ? paths[t] : NULL, window, warmup,
+                           history, context_bits, num_threads, csv);
+    }
+
+    if (csv != NULL && fclose(csv) != 0)
+    {
+        perror(csv_path);
+        ok = 0;
+    }
+    free(paths);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,1074 @@
+//========================================================//
+//  verify.c                                              //
+//  Differential verification of the predictor engines    //
+//                                                        //
+//  Runs every way of simulating a predictor side by side //
+//  with a reference and stops at the first divergence    //
+//========================================================//
+
+#include "lanes.h"
+#include "pool.h"
+#include "predictor.h"
+#include "shard.h"
+#include "sim.h"
+#include "state.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Predictors verified when none is given: every type, a second gshare
+// geometry for the lanes, and the side components over each base
+const char* defaultSpecs[] = {"static",
+                              "gshare",
+                              "gshare:9",
+                              "tournament",
+                              "custom",
+                              "tage",
+                              "perceptron",
+                              "gshare+loop+sc",
+                              "tournament+loop+sc",
+                              "tage+loop+sc",
+                              "perceptron+loop+sc"};
+#define NUM_DEFAULT_SPECS (sizeof(defaultSpecs) / sizeof(defaultSpecs[0]))
+
+// Differing state entries printed in a dump
+#define DUMP_MAX 16
+
+// Branches between two comparisons of the table state
+uint64_t checkEvery = 65536;
+
+// Shards of the sharded engine, and threads running them
+int numShards = 4;
+int numThreads = 0;
+
+// Print out the Usage information to stderr
+//
+void usage()
+{
+    fprintf(stderr, "Usage: verify <options> [<trace>...]\n");
+    fprintf(stderr, " Options:\n");
+    fprintf(stderr, " --help            Print this message\n");
+    fprintf(stderr, " --<type>          Predictor to verify, may be repeated\n"
+                    "                   with any spec, e.g. --gshare:12+loop\n"
+                    "                   (default: every type, with and\n"
+                    "                   without side components)\n");
+    fprintf(stderr, " --random <n>      Also verify on n random synthetic\n"
+                    "                   traces (default: 4)\n");
+    fprintf(stderr, " --branches <n>    Branches per random trace\n"
+                    "                   (default: 1000000)\n");
+    fprintf(stderr, " --seed <n>        Seed of the first random trace\n"
+                    "                   (default: 1)\n");
+    fprintf(stderr, " --check-every <n> Branches between comparisons of the\n"
+                    "                   table state (default: 65536)\n");
+    fprintf(stderr, " --shards <n>      Shards of the sharded engine\n"
+                    "                   (default: 4)\n");
+    fprintf(stderr, " --threads <n>     Threads of the sharded engine\n"
+                    "                   (default: one per core)\n");
+}
+
+//------------------------------------//
+//         Reference Models           //
+//------------------------------------//
+
+// Frozen, deliberately plain copies of the original gshare, tournament
+// and custom predictors: one unpacked value per entry, textbook counter
+// updates and no code shared with predictor.c or counters.h. Do not
+// optimize them; they are what the engines are held to.
+
+#define REF_MAX_FIELDS 5
+
+typedef struct
+{
+    const char* name;
+    uint32_t entries;
+    int bits;
+    uint64_t* val;
+} ref_field_t;
+
+// The fields are listed in the order of predictor_state()
+typedef struct
+{
+    bp_config_t cfg;
+    int num_fields;
+    ref_field_t field[REF_MAX_FIELDS];
+} ref_t;
+
+#define GS_BHT      0
+#define GS_GHISTORY 1
+
+#define TRN_PHT      0
+#define TRN_LBHT     1
+#define TRN_GBHT     2
+#define TRN_CHOOSER  3
+#define TRN_GHISTORY 4
+
+static void ref_field(ref_t* r, const char* name, uint32_t entries, int bits,
+                      uint64_t init)
+{
+    ref_field_t* f = &r->field[r->num_fields++];
+    f->name = name;
+    f->entries = entries;
+    f->bits = bits;
+    f->val = (uint64_t*)malloc(entries * sizeof(uint64_t));
+    for (uint32_t i = 0; i < entries; i++)
+    {
+        f->val[i] = init;
+    }
+}
+
+// Create the reference model of 'cfg'
+//
+// Returns NULL for the predictors without one
+//
+static ref_t* ref_create(const bp_config_t* cfg)
+{
+    if (cfg->loopBits > 0 || cfg->scBits > 0)
+    {
+        return NULL;
+    }
+
+    ref_t* r = (ref_t*)calloc(1, sizeof(ref_t));
+    r->cfg = *cfg;
+    switch (cfg->bpType)
+    {
+    case STATIC:
+        break;
+    case GSHARE:
+        ref_field(r, "bht", 1u << cfg->ghistoryBits, 2, WN);
+        ref_field(r, "ghistory", 1, 64, 0);
+        break;
+    case TOURNAMENT:
+    case CUSTOM:
+        ref_field(r, "local pht", 1u << cfg->pcIndexBits, cfg->lhistoryBits,
+                  0);
+        ref_field(r, "local bht", 1u << cfg->lhistoryBits, 2, WT);
+        ref_field(r, "global bht", 1u << cfg->ghistoryBits, 2, WT);
+        ref_field(r, "chooser", 1u << cfg->chooserBits, 3, WT);
+        ref_field(r, "ghistory", 1, 64, 0);
+        break;
+    default:
+        free(r);
+        return NULL;
+    }
+    return r;
+}
+
+static void ref_destroy(ref_t* r)
+{
+    for (int f = 0; f < r->num_fields; f++)
+    {
+        free(r->field[f].val);
+    }
+    free(r);
+}
+
+// Count a saturating counter of 'bits' bits up or down
+//
+static uint64_t ref_count(uint64_t ctr, int bits, int up)
+{
+    uint64_t max = (1ULL << bits) - 1;
+    if (up)
+    {
+        return ctr < max ? ctr + 1 : ctr;
+    }
+    return ctr > 0 ? ctr - 1 : ctr;
+}
+
+static uint8_t ref_msb(uint64_t ctr, int bits)
+{
+    return (ctr >> (bits - 1)) & 0x1;
+}
+
+// Predict the branch at 'pc', then train with 'outcome'
+//
+// Returns the prediction
+//
+static uint8_t ref_step(ref_t* r, uint32_t pc, uint8_t outcome)
+{
+    ref_field_t* f = r->field;
+
+    switch (r->cfg.bpType)
+    {
+    case GSHARE:
+    {
+        uint64_t* ghistory = &f[GS_GHISTORY].val[0];
+        uint64_t* bht = f[GS_BHT].val;
+        uint32_t i = (pc ^ *ghistory) & (f[GS_BHT].entries - 1);
+
+        uint8_t pred = ref_msb(bht[i], 2);
+        bht[i] = ref_count(bht[i], 2, outcome == TAKEN);
+        *ghistory = (*ghistory << 1) | outcome;
+        return pred;
+    }
+    case TOURNAMENT:
+    case CUSTOM:
+    {
+        uint64_t* ghistory = &f[TRN_GHISTORY].val[0];
+        uint64_t g = r->cfg.bpType == CUSTOM ? *ghistory ^ pc : *ghistory;
+        uint32_t gi = g & (f[TRN_GBHT].entries - 1);
+        uint32_t ci = *ghistory & (f[TRN_CHOOSER].entries - 1);
+        uint32_t li = pc & (f[TRN_PHT].entries - 1);
+        uint64_t pat = f[TRN_PHT].val[li];
+
+        uint8_t global = ref_msb(f[TRN_GBHT].val[gi], 2);
+        uint8_t local = ref_msb(f[TRN_LBHT].val[pat], 2);
+        uint8_t pred = ref_msb(f[TRN_CHOOSER].val[ci], 3) ? global : local;
+
+        if (global != local)
+        {
+            f[TRN_CHOOSER].val[ci] =
+                ref_count(f[TRN_CHOOSER].val[ci], 3, global == outcome);
+        }
+        f[TRN_PHT].val[li] =
+            ((pat << 1) | outcome) & ((1ULL << f[TRN_PHT].bits) - 1);
+        f[TRN_GBHT].val[gi] =
+            ref_count(f[TRN_GBHT].val[gi], 2, outcome == TAKEN);
+        f[TRN_LBHT].val[pat] =
+            ref_count(f[TRN_LBHT].val[pat], 2, outcome == TAKEN);
+        *ghistory = (*ghistory << 1) | outcome;
+        return pred;
+    }
+    default:
+        return TAKEN;
+    }
+}
+
+static size_t field_bytes(const ref_field_t* f)
+{
+    return ((uint64_t)f->entries * f->bits + 7) / 8;
+}
+
+// Get entry 'i' of a field of 'bits' bits packed at 'img'
+//
+static uint64_t image_entry(const uint8_t* img, int bits, uint32_t i)
+{
+    uint64_t val = 0;
+    for (int b = 0; b < bits; b++)
+    {
+        uint64_t bit = (uint64_t)i * bits + b;
+        val |= (uint64_t)((img[bit >> 3] >> (bit & 7)) & 0x1) << b;
+    }
+    return val;
+}
+
+// Write the state of 'r' to 'img' in the layout of predictor_state(),
+// each field packed at its width. Only measures it when 'img' is NULL.
+//
+// Returns the size of the state in bytes
+//
+static size_t ref_image(const ref_t* r, uint8_t* img)
+{
+    size_t pos = 0;
+    for (int k = 0; k < r->num_fields; k++)
+    {
+        const ref_field_t* f = &r->field[k];
+        if (img != NULL)
+        {
+            uint8_t* p = img + pos;
+            memset(p, 0, field_bytes(f));
+            for (uint32_t i = 0; i < f->entries; i++)
+            {
+                for (int b = 0; b < f->bits; b++)
+                {
+                    uint64_t bit = (uint64_t)i * f->bits + b;
+                    p[bit >> 3] |= ((f->val[i] >> b) & 0x1) << (bit & 7);
+                }
+            }
+        }
+        pos += field_bytes(f);
+    }
+    return pos;
+}
+
+//------------------------------------//
+//            Reference               //
+//------------------------------------//
+
+// The reference of a predictor is its model when there is one, and the
+// per-branch predict and train functions of predictor.c otherwise
+typedef struct
+{
+    ref_t* model;
+    predictor_t* bp;
+} oracle_t;
+
+static void oracle_init(oracle_t* o, const bp_config_t* cfg)
+{
+    o->model = ref_create(cfg);
+    o->bp = o->model == NULL ? predictor_create(cfg) : NULL;
+}
+
+static void oracle_free(oracle_t* o)
+{
+    if (o->model != NULL)
+        ref_destroy(o->model);
+    if (o->bp != NULL)
+        predictor_destroy(o->bp);
+}
+
+static uint8_t oracle_step(oracle_t* o, uint32_t pc, uint8_t outcome)
+{
+    if (o->model != NULL)
+    {
+        return ref_step(o->model, pc, outcome);
+    }
+    uint8_t pred = predictor_predict(o->bp, pc);
+    predictor_train(o->bp, pc, outcome);
+    return pred;
+}
+
+// Write the state of 'p' to 'img', or only measure it when 'img' is NULL
+//
+// Returns the size of the state in bytes
+//
+static size_t predictor_image(predictor_t* p, uint8_t* img, size_t len)
+{
+    bp_state_t s = {img, 0, len, 0};
+    predictor_state(p, &s);
+    return s.pos;
+}
+
+static size_t oracle_image(oracle_t* o, uint8_t* img, size_t len)
+{
+    if (o->model != NULL)
+    {
+        return ref_image(o->model, img);
+    }
+    return predictor_image(o->bp, img, len);
+}
+
+//------------------------------------//
+//             Engines                //
+//------------------------------------//
+
+// An engine predicts and trains 'count' branches, writing the
+// predictions as a bitmap to 'pred' when it knows them
+//
+// Returns the number of mispredictions
+//
+typedef uint64_t (*engine_run_t)(predictor_t* p, const uint32_t* pc,
+                                 uint64_t taken, int count, uint64_t* pred);
+
+typedef struct
+{
+    const char* name;
+    engine_run_t run;
+    int per_branch; // sets 'pred'
+} engine_t;
+
+static uint64_t valid_mask(int count)
+{
+    return count < 64 ? (1ULL << count) - 1 : ~0ULL;
+}
+
+static uint64_t run_predict_train(predictor_t* p, const uint32_t* pc,
+                                  uint64_t taken, int count, uint64_t* pred)
+{
+    *pred = 0;
+    for (int i = 0; i < count; i++)
+    {
+        uint8_t outcome = (taken >> i) & 0x1;
+        *pred |= (uint64_t)predictor_predict(p, pc[i]) << i;
+        predictor_train(p, pc[i], outcome);
+    }
+    return __builtin_popcountll((*pred ^ taken) & valid_mask(count));
+}
+
+static uint64_t run_lookup_update(predictor_t* p, const uint32_t* pc,
+                                  uint64_t taken, int count, uint64_t* pred)
+{
+    *pred = 0;
+    for (int i = 0; i < count; i++)
+    {
+        bp_lookup_t rec;
+        uint8_t outcome = (taken >> i) & 0x1;
+        *pred |= (uint64_t)predictor_lookup(p, pc[i], &rec) << i;
+        predictor_update(p, &rec, outcome);
+    }
+    return __builtin_popcountll((*pred ^ taken) & valid_mask(count));
+}
+
+static uint64_t run_fused(predictor_t* p, const uint32_t* pc,
+                          uint64_t taken, int count, uint64_t* pred)
+{
+    *pred = 0;
+    for (int i = 0; i < count; i++)
+    {
+        uint8_t outcome = (taken >> i) & 0x1;
+        *pred |= (uint64_t)predictor_predict_and_update(p, pc[i], outcome)
+                 << i;
+    }
+    return __builtin_popcountll((*pred ^ taken) & valid_mask(count));
+}
+
+static uint64_t run_block(predictor_t* p, const uint32_t* pc,
+                          uint64_t taken, int count, uint64_t* pred)
+{
+    (void)pred;
+    return predictor_run(p, pc, taken, count);
+}
+
+// The first engine is the reference itself for predictors without a
+// model, and is then skipped
+#define NUM_ENGINES 4
+const engine_t engines[NUM_ENGINES] = {
+    {"predict/train", run_predict_train, 1},
+    {"lookup/update", run_lookup_update, 1},
+    {"predict_and_update", run_fused, 1},
+    {"predictor_run", run_block, 0}};
+
+//------------------------------------//
+//         Divergence Reports         //
+//------------------------------------//
+
+// Print the entries where the states 'ref' and 'eng' of 'len' bytes
+// differ, by field when the reference has a model
+//
+static void dump_state(const oracle_t* o, const uint8_t* ref,
+                       const uint8_t* eng, size_t len)
+{
+    size_t bytes = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        bytes += ref[i] != eng[i];
+    }
+    if (bytes == 0)
+    {
+        printf("  The table state is identical\n");
+        return;
+    }
+    printf("  The table state differs in %zu of %zu bytes:\n", bytes, len);
+
+    int shown = 0;
+    if (o->model != NULL)
+    {
+        size_t pos = 0;
+        for (int k = 0; k < o->model->num_fields; k++)
+        {
+            const ref_field_t* f = &o->model->field[k];
+            for (uint32_t i = 0; i < f->entries && shown < DUMP_MAX; i++)
+            {
+                uint64_t r = image_entry(ref + pos, f->bits, i);
+                uint64_t e = image_entry(eng + pos, f->bits, i);
+                if (r != e)
+                {
+                    printf("    %-10s [%6u]  reference %#llx, engine %#llx\n",
+                           f->name, i, (unsigned long long)r,
+                           (unsigned long long)e);
+                    shown++;
+                }
+            }
+            pos += field_bytes(f);
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < len && shown < DUMP_MAX; i++)
+    {
+        if (ref[i] != eng[i])
+        {
+            printf("    byte %8zu  reference 0x%02x, engine 0x%02x\n", i,
+                   ref[i], eng[i]);
+            shown++;
+        }
+    }
+}
+
+static void print_branch(const trace_mem_t* mem, uint64_t n)
+{
+    const trace_block_t* blk = &mem->blocks[n / TRACE_BLOCK];
+    int i = n % TRACE_BLOCK;
+    printf("  Branch %llu: pc 0x%08x, outcome %s\n", (unsigned long long)n,
+           blk->pc[i], (blk->taken >> i) & 0x1 ? "T" : "N");
+}
+
+// Restore 'p' to the state 'img' of 'len' bytes
+//
+static void predictor_restore(predictor_t* p, uint8_t* img, size_t len)
+{
+    bp_state_t s = {img, 0, len, 1};
+    predictor_state(p, &s);
+}
+
+// Find the first branch in ['from', 'to') where engine 'e' diverges from
+// the reference on 'cfg', and print its predictions and state. Both are
+// replayed from cold up to 'from'. Then each branch i of a block is run
+// by restoring the engine to the start of the block and running the
+// first i + 1 branches, so that engines running whole blocks are held
+// to every branch as well.
+//
+static void locate(const trace_mem_t* mem, const bp_config_t* cfg, int e,
+                   uint64_t from, uint64_t to)
+{
+    oracle_t o;
+    oracle_init(&o, cfg);
+    predictor_t* bp = predictor_create(cfg);
+    size_t len = predictor_image(bp, NULL, 0);
+    uint8_t* ref_img = (uint8_t*)malloc(len);
+    uint8_t* eng_img = (uint8_t*)malloc(len);
+    uint8_t* start_img = (uint8_t*)malloc(len);
+    uint64_t pred;
+
+    // 'from' starts a block, and the blocks before it agreed
+    for (uint64_t b = 0; b < from / TRACE_BLOCK; b++)
+    {
+        const trace_block_t* blk = &mem->blocks[b];
+        for (int i = 0; i < TRACE_BLOCK; i++)
+        {
+            oracle_step(&o, blk->pc[i], (blk->taken >> i) & 0x1);
+        }
+        engines[e].run(bp, blk->pc, blk->taken, TRACE_BLOCK, &pred);
+    }
+
+    int found = 0;
+    for (uint64_t b = from / TRACE_BLOCK; !found && b * TRACE_BLOCK < to;
+         b++)
+    {
+        const trace_block_t* blk = &mem->blocks[b];
+        int count = trace_mem_count(mem, b);
+        uint64_t before = 0;
+        predictor_image(bp, start_img, len);
+
+        for (int i = 0; !found && i < count; i++)
+        {
+            uint8_t outcome = (blk->taken >> i) & 0x1;
+            uint8_t ref = oracle_step(&o, blk->pc[i], outcome);
+
+            predictor_restore(bp, start_img, len);
+            uint64_t m = engines[e].run(bp, blk->pc, blk->taken, i + 1, &pred);
+            uint8_t eng = outcome ^ (uint8_t)(m - before);
+            before = m;
+
+            oracle_image(&o, ref_img, len);
+            predictor_image(bp, eng_img, len);
+            if (ref != eng || memcmp(ref_img, eng_img, len))
+            {
+                print_branch(mem, b * TRACE_BLOCK + i);
+                printf("  Reference predicted %s, %s predicted %s\n",
+                       ref ? "T" : "N", engines[e].name, eng ? "T" : "N");
+                printf("  State after training on it:\n");
+                dump_state(&o, ref_img, eng_img, len);
+                found = 1;
+            }
+        }
+    }
+    if (!found)
+    {
+        printf("  Not reproduced branch by branch over branches %llu to "
+               "%llu\n", (unsigned long long)from,
+               (unsigned long long)to - 1);
+    }
+
+    free(ref_img);
+    free(eng_img);
+    free(start_img);
+    predictor_destroy(bp);
+    oracle_free(&o);
+}
+
+//------------------------------------//
+//           Verification             //
+//------------------------------------//
+
+// Get the reference mispredictions over the first 'n' branches of 'mem'
+// from the prediction bitmaps 'ref_pred' of its blocks
+//
+static uint64_t ref_misses(const trace_mem_t* mem, const uint64_t* ref_pred,
+                           uint64_t n)
+{
+    uint64_t misses = 0;
+    for (uint64_t b = 0; b * TRACE_BLOCK < n; b++)
+    {
+        uint64_t left = n - b * TRACE_BLOCK;
+        int count = left < TRACE_BLOCK ? (int)left : TRACE_BLOCK;
+        misses += __builtin_popcountll((ref_pred[b] ^ mem->blocks[b].taken) &
+                                       valid_mask(count));
+    }
+    return misses;
+}
+
+// Run the reference and every per-branch engine over 'mem' in lockstep,
+// comparing each block of predictions and, every checkEvery branches
+// and at the end, the table state. The reference predictions of each
+// block are written to 'ref_pred'.
+//
+// Returns True if no engine diverged
+//
+static int verify_engines(const trace_mem_t* mem, const bp_config_t* cfg,
+                          uint64_t* ref_pred)
+{
+    oracle_t o;
+    oracle_init(&o, cfg);
+    int first = o.model != NULL ? 0 : 1;
+    predictor_t* bp[NUM_ENGINES] = {NULL};
+    for (int e = first; e < NUM_ENGINES; e++)
+    {
+        bp[e] = predictor_create(cfg);
+    }
+
+    size_t len = predictor_image(bp[first], NULL, 0);
+    uint8_t* ref_img = (uint8_t*)malloc(len);
+    uint8_t* eng_img = (uint8_t*)malloc(len);
+    uint64_t check_blocks = (checkEvery + TRACE_BLOCK - 1) / TRACE_BLOCK;
+    uint64_t checked = 0; // branches up to the last state comparison
+    int ok = 1;
+
+    if (oracle_image(&o, NULL, 0) != len)
+    {
+        printf("state of %zu bytes, the reference's is %zu\n", len,
+               oracle_image(&o, NULL, 0));
+        ok = 0;
+    }
+
+    for (uint64_t b = 0; ok && b < mem->num_blocks; b++)
+    {
+        const trace_block_t* blk = &mem->blocks[b];
+        int count = trace_mem_count(mem, b);
+
+        uint64_t pred = 0;
+        for (int i = 0; i < count; i++)
+        {
+            uint8_t outcome = (blk->taken >> i) & 0x1;
+            pred |= (uint64_t)oracle_step(&o, blk->pc[i], outcome) << i;
+        }
+        ref_pred[b] = pred;
+        uint64_t misses =
+            __builtin_popcountll((pred ^ blk->taken) & valid_mask(count));
+
+        for (int e = first; ok && e < NUM_ENGINES; e++)
+        {
+            uint64_t eng = 0;
+            uint64_t m =
+                engines[e].run(bp[e], blk->pc, blk->taken, count, &eng);
+            if (m != misses || (engines[e].per_branch && eng != pred))
+            {
+                printf("%s diverged in block %llu\n", engines[e].name,
+                       (unsigned long long)b);
+                // the state may have diverged since it was last checked
+                locate(mem, cfg, e, checked, b * TRACE_BLOCK + count);
+                ok = 0;
+            }
+        }
+
+        uint64_t done = b * TRACE_BLOCK + count;
+        if (ok && ((b + 1) % check_blocks == 0 || b + 1 == mem->num_blocks))
+        {
+            oracle_image(&o, ref_img, len);
+            for (int e = first; ok && e < NUM_ENGINES; e++)
+            {
+                predictor_image(bp[e], eng_img, len);
+                if (memcmp(ref_img, eng_img, len))
+                {
+                    printf("%s state diverged by branch %llu\n",
+                           engines[e].name, (unsigned long long)done);
+                    locate(mem, cfg, e, checked, done);
+                    ok = 0;
+                }
+            }
+            checked = done;
+        }
+    }
+
+    free(ref_img);
+    free(eng_img);
+    for (int e = first; e < NUM_ENGINES; e++)
+    {
+        predictor_destroy(bp[e]);
+    }
+    oracle_free(&o);
+    return ok;
+}
+
+// The first 'n' branches of 'mem', sharing its blocks
+//
+static trace_mem_t prefix(const trace_mem_t* mem, uint64_t n)
+{
+    trace_mem_t view = *mem;
+    view.num_branches = n;
+    view.num_blocks = (n + TRACE_BLOCK - 1) / TRACE_BLOCK;
+    view.trace = NULL;
+    view.owned = NULL;
+    return view;
+}
+
+// Run the 'num' geometries of 'cfgs' together in the lanes and compare
+// each count with the reference predictions 'ref_pred[i]'. For a lane
+// that diverges, the shortest diverging prefix of the trace is searched.
+//
+// Returns True if no lane diverged
+//
+static int verify_lanes(const trace_mem_t* mem, const bp_config_t* cfgs,
+                        int num, uint64_t** ref_pred, const char** names)
+{
+    uint64_t misses[LANES_WIDTH];
+    lanes_run(cfgs, num, mem, misses);
+
+    for (int k = 0; k < num; k++)
+    {
+        uint64_t ref = ref_misses(mem, ref_pred[k], mem->num_branches);
+        if (misses[k] == ref)
+        {
+            continue;
+        }
+
+        printf("%s: lanes (%s) diverged: %llu mispredictions, reference "
+               "%llu\n", names[k], lanes_kernel(),
+               (unsigned long long)misses[k], (unsigned long long)ref);
+
+        // the counts agree over 'lo' branches and differ over 'hi'
+        uint64_t lo = 0;
+        uint64_t hi = mem->num_branches;
+        while (hi - lo > 1)
+        {
+            uint64_t mid = lo + (hi - lo) / 2;
+            trace_mem_t view = prefix(mem, mid);
+            lanes_run(cfgs, num, &view, misses);
+            if (misses[k] == ref_misses(mem, ref_pred[k], mid))
+                lo = mid;
+            else
+                hi = mid;
+        }
+        print_branch(mem, hi - 1);
+        uint8_t ref_bit = (ref_pred[k][(hi - 1) / TRACE_BLOCK] >>
+                           ((hi - 1) % TRACE_BLOCK)) & 0x1;
+        printf("  Reference predicted %s, the lane the opposite\n",
+               ref_bit ? "T" : "N");
+        printf("  The lanes keep no state that can be compared\n");
+        return 0;
+    }
+    return 1;
+}
+
+// Simulate the 'num' predictors of 'cfgs' in shards warmed on every
+// branch before them, which must give the reference counts
+//
+// Returns True if no predictor diverged
+//
+static int verify_shards(const trace_mem_t* mem, const bp_config_t* cfgs,
+                         int num, uint64_t** ref_pred, const char** names)
+{
+    uint64_t* misses = (uint64_t*)malloc(num * sizeof(uint64_t));
+    uint64_t n = mem->num_branches;
+    int ok = 1;
+
+    shard_run(mem, cfgs, num, numShards, n, numThreads, misses, NULL);
+
+    for (int k = 0; ok && k < num; k++)
+    {
+        uint64_t ref = ref_misses(mem, ref_pred[k], n);
+        if (misses[k] == ref)
+        {
+            continue;
+        }
+        ok = 0;
+        printf("%s: shards diverged: %llu mispredictions, reference %llu\n",
+               names[k], (unsigned long long)misses[k],
+               (unsigned long long)ref);
+
+        // rerun the shards one at a time, as shard_run() splits them
+        int s;
+        for (s = 0; s < numShards; s++)
+        {
+            uint64_t first = n * s / numShards;
+            uint64_t count = n * (s + 1) / numShards - first;
+            uint64_t base = ref_misses(mem, ref_pred[k], first);
+            predictor_t* bp = predictor_create(&cfgs[k]);
+            uint64_t m = sim_run_range(bp, mem, first, count, first);
+            predictor_destroy(bp);
+            if (m == ref_misses(mem, ref_pred[k], first + count) - base)
+            {
+                continue;
+            }
+
+            // the counts agree over 'lo' branches of the shard
+            uint64_t lo = 0;
+            uint64_t hi = count;
+            while (hi - lo > 1)
+            {
+                uint64_t mid = lo + (hi - lo) / 2;
+                bp = predictor_create(&cfgs[k]);
+                m = sim_run_range(bp, mem, first, mid, first);
+                predictor_destroy(bp);
+                if (m == ref_misses(mem, ref_pred[k], first + mid) - base)
+                    lo = mid;
+                else
+                    hi = mid;
+            }
+            printf("  Shard %d diverged first\n", s);
+            print_branch(mem, first + hi - 1);
+            break;
+        }
+        if (s == numShards)
+        {
+            printf("  Every shard agrees when run alone, so shard_run() "
+                   "splits or merges\n  the shards wrongly\n");
+        }
+    }
+
+    free(misses);
+    return ok;
+}
+
+// Verify every predictor of 'cfgs' on 'mem'
+//
+// Returns True if every engine agreed with the reference
+//
+static int verify_trace(const trace_mem_t* mem, const char* label,
+                        const bp_config_t* cfgs, int num)
+{
+    uint64_t** ref_pred = (uint64_t**)malloc(num * sizeof(uint64_t*));
+    const char** names = (const char**)malloc(num * sizeof(char*));
+    char(*buf)[64] = (char(*)[64])malloc(num * sizeof(*buf));
+    int ok = 1;
+
+    for (int i = 0; i < num; i++)
+    {
+        predictor_config_name(&cfgs[i], buf[i], sizeof(buf[i]));
+        names[i] = buf[i];
+        ref_pred[i] =
+            (uint64_t*)malloc((mem->num_blocks + 1) * sizeof(uint64_t));
+    }
+
+    for (int i = 0; ok && i < num; i++)
+    {
+        printf("%-12.12s %-36s ", label, names[i]);
+        fflush(stdout);
+        // a divergence is reported on the rest of the line
+        ok = verify_engines(mem, &cfgs[i], ref_pred[i]);
+        if (ok)
+        {
+            printf("%10llu ok\n",
+                   (unsigned long long)ref_misses(mem, ref_pred[i],
+                                                  mem->num_branches));
+        }
+    }
+
+    // The lanes run up to LANES_WIDTH supported geometries together
+    bp_config_t group[LANES_WIDTH];
+    uint64_t* group_pred[LANES_WIDTH];
+    const char* group_names[LANES_WIDTH];
+    int grouped = 0;
+    for (int i = 0; ok && i <= num; i++)
+    {
+        if (i < num && lanes_supported(&cfgs[i]))
+        {
+            group[grouped] = cfgs[i];
+            group_pred[grouped] = ref_pred[i];
+            group_names[grouped++] = names[i];
+        }
+        if (grouped > 0 && (grouped == LANES_WIDTH || i == num))
+        {
+            ok = verify_lanes(mem, group, grouped, group_pred, group_names);
+            grouped = 0;
+        }
+    }
+
+    if (ok)
+    {
+        ok = verify_shards(mem, cfgs, num, ref_pred, names);
+    }
+
+    for (int i = 0; i < num; i++)
+    {
+        free(ref_pred[i]);
+    }
+    free(ref_pred);
+    free(names);
+    free(buf);
+    return ok;
+}
+
+//------------------------------------//
+//         Synthetic Traces           //
+//------------------------------------//
+
+// Static branches of a random program
+#define RANDOM_SITES 1024
+
+static uint64_t xorshift(uint64_t* s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+// Fill 'mem' with 'n' branches of a random program of biased branches,
+// loops, branches following the global history and coin flips, at PCs
+// spread over the whole address space
+//
+static void random_trace(trace_mem_t* mem, uint64_t n, uint64_t seed)
+{
+    uint32_t pc[RANDOM_SITES];
+    int kind[RANDOM_SITES];
+    int param[RANDOM_SITES];
+    int iter[RANDOM_SITES] = {0};
+    uint64_t s = seed * 0x9e3779b97f4a7c15ULL + 1;
+
+    for (int i = 0; i < RANDOM_SITES; i++)
+    {
+        pc[i] = (uint32_t)xorshift(&s) & ~0x3u;
+        kind[i] = xorshift(&s) % 4;
+        param[i] = 1 + xorshift(&s) % 15;
+    }
+
+    memset(mem, 0, sizeof(*mem));
+    mem->num_branches = n;
+    mem->num_blocks = (n + TRACE_BLOCK - 1) / TRACE_BLOCK;
+    mem->owned = (trace_block_t*)calloc(mem->num_blocks + 1,
+                                        sizeof(trace_block_t));
+    mem->blocks = mem->owned;
+
+    uint64_t history = 0;
+    int site = 0;
+    for (uint64_t k = 0; k < n; k++)
+    {
+        uint8_t taken;
+        switch (kind[site])
+        {
+        case 0: // biased by param / 16
+            taken = (int)(xorshift(&s) % 16) < param[site];
+            break;
+        case 1: // a loop of param iterations
+            taken = ++iter[site] < param[site];
+            if (!taken)
+                iter[site] = 0;
+            break;
+        case 2: // the parity of the last param outcomes
+            taken = __builtin_parityll(history & ((1ULL << param[site]) - 1));
+            break;
+        default:
+            taken = xorshift(&s) & 0x1;
+            break;
+        }
+
+        trace_block_t* blk = &mem->owned[k / TRACE_BLOCK];
+        blk->pc[k % TRACE_BLOCK] = pc[site];
+        blk->taken |= (uint64_t)taken << (k % TRACE_BLOCK);
+        history = (history << 1) | taken;
+
+        // loops branch back to themselves
+        if (!(kind[site] == 1 && taken))
+        {
+            site = (site + 1 + xorshift(&s) % 3) % RANDOM_SITES;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    bp_config_t cfgs[64];
+    int num_cfgs = 0;
+    char** traces = (char**)malloc(argc * sizeof(char*));
+    int num_traces = 0;
+    int num_random = 4;
+    uint64_t random_branches = 1000000;
+    uint64_t seed = 1;
+
+    // Process cmdline Arguments
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--help"))
+        {
+            usage();
+            exit(0);
+        }
+        else if (!strcmp(argv[i], "--random") && i + 1 < argc)
+        {
+            num_random = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--branches") && i + 1 < argc)
+        {
+            random_branches = strtoull(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+        {
+            seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--check-every") && i + 1 < argc)
+        {
+            checkEvery = strtoull(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--shards") && i + 1 < argc)
+        {
+            numShards = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+        {
+            numThreads = atoi(argv[++i]);
+        }
+        else if (!strncmp(argv[i], "--", 2) && num_cfgs < 64 &&
+                 predictor_parse_config(argv[i] + 2, &cfgs[num_cfgs]))
+        {
+            num_cfgs++;
+        }
+        else if (!strncmp(argv[i], "--", 2))
+        {
+            printf("Unrecognized option %s\n", argv[i]);
+            usage();
+            exit(1);
+        }
+        else
+        {
+            traces[num_traces++] = argv[i];
+        }
+    }
+
+    if (num_cfgs == 0)
+    {
+        for (size_t i = 0; i < NUM_DEFAULT_SPECS; i++)
+        {
+            predictor_parse_config(defaultSpecs[i], &cfgs[num_cfgs++]);
+        }
+    }
+    if (checkEvery < 1)
+    {
+        checkEvery = 1;
+    }
+    if (numShards < 1)
+    {
+        numShards = 1;
+    }
+    if (numThreads < 1)
+    {
+        numThreads = pool_default_threads();
+    }
+
+    printf("%-12s %-36s %10s\n", "Trace", "Predictor", "Incorrect");
+
+    int ok = 1;
+    for (int t = 0; ok && t < num_traces + num_random; t++)
+    {
+        trace_mem_t mem;
+        char label[32];
+        const char* name = label;
+        if (t < num_traces)
+        {
+            if (!trace_load(&mem, traces[t]))
+            {
+                fprintf(stderr, "Failed to load %s\n", traces[t]);
+                exit(1);
+            }
+            name = strrchr(traces[t], '/') ? strrchr(traces[t], '/') + 1
+                                           : traces[t];
+        }
+        else
+        {
+            uint64_t s = seed + t - num_traces;
+            random_trace(&mem, random_branches, s);
+            snprintf(label, sizeof(label), "random:%llu",
+                     (unsigned long long)s);
+        }
+
+        ok = verify_trace(&mem, name, cfgs, num_cfgs);
+        trace_unload(&mem);
+    }
+
+    if (ok)
+    {
+        printf("Every engine matched the reference\n");
+    }
+    free(traces);
+    return ok ? 0 : 1;
+}
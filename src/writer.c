@@ -0,0 +1,212 @@
+//========================================================//
+//  writer.c                                              //
+//  Source file for the asynchronous output writer        //
+//                                                        //
+//  A ring of buffers is filled by the caller and written //
+//  out in order by a background thread                   //
+//========================================================//
+
+#define _GNU_SOURCE
+#include "writer.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Size and number of the buffers
+#define WRITER_BUF_SIZE (1 << 16)
+#define WRITER_BUFS     4
+
+// bufs[head] .. bufs[head + full - 1] are queued for the writer thread,
+// the caller fills bufs[cur], the one after them
+struct writer
+{
+    FILE* file;
+    int owned; // close the file at the end
+
+    char* bufs[WRITER_BUFS];
+    size_t len[WRITER_BUFS];
+    int cur;
+    int head;
+    int full;
+    int done;
+    int error; // set by the writer thread, read without the lock
+    int started;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+};
+
+static void* writer_thread(void* arg)
+{
+    writer_t* w = (writer_t*)arg;
+
+    pthread_mutex_lock(&w->lock);
+    for (;;)
+    {
+        while (w->full == 0 && !w->done)
+        {
+            pthread_cond_wait(&w->cond, &w->lock);
+        }
+        if (w->full == 0)
+        {
+            break;
+        }
+
+        // write without holding the lock, the buffer stays queued
+        int idx = w->head;
+        pthread_mutex_unlock(&w->lock);
+        size_t len = w->len[idx];
+        int ok = fwrite(w->bufs[idx], 1, len, w->file) == len;
+        pthread_mutex_lock(&w->lock);
+
+        if (!ok)
+        {
+            __atomic_store_n(&w->error, 1, __ATOMIC_RELAXED);
+        }
+        w->len[idx] = 0;
+        w->head = (w->head + 1) % WRITER_BUFS;
+        w->full--;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    return NULL;
+}
+
+// Queue the current buffer and move on to the next free one
+//
+static void submit(writer_t* w)
+{
+    pthread_mutex_lock(&w->lock);
+    w->full++;
+    pthread_cond_broadcast(&w->cond);
+    while (w->full == WRITER_BUFS)
+    {
+        pthread_cond_wait(&w->cond, &w->lock);
+    }
+    w->cur = (w->head + w->full) % WRITER_BUFS;
+    pthread_mutex_unlock(&w->lock);
+}
+
+writer_t* writer_open(const char* path)
+{
+    FILE* file = stdout;
+    if (path != NULL && strcmp(path, "-") != 0)
+    {
+        if ((file = fopen(path, "wb")) == NULL)
+        {
+            perror(path);
+            return NULL;
+        }
+    }
+
+    writer_t* w = (writer_t*)calloc(1, sizeof(writer_t));
+    w->file = file;
+    w->owned = file != stdout;
+    for (int i = 0; i < WRITER_BUFS; i++)
+    {
+        w->bufs[i] = (char*)malloc(WRITER_BUF_SIZE);
+    }
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+
+    if (pthread_create(&w->thread, NULL, writer_thread, w) != 0)
+    {
+        fprintf(stderr, "Failed to start the writer thread\n");
+        writer_close(w);
+        return NULL;
+    }
+    w->started = 1;
+    return w;
+}
+
+int writer_write(writer_t* w, const void* data, size_t len)
+{
+    const char* src = (const char*)data;
+    while (len > 0)
+    {
+        size_t n = WRITER_BUF_SIZE - w->len[w->cur];
+        n = n < len ? n : len;
+        memcpy(w->bufs[w->cur] + w->len[w->cur], src, n);
+        w->len[w->cur] += n;
+        src += n;
+        len -= n;
+
+        if (w->len[w->cur] == WRITER_BUF_SIZE)
+        {
+            submit(w);
+        }
+    }
+    return !__atomic_load_n(&w->error, __ATOMIC_RELAXED);
+}
+
+int writer_printf(writer_t* w, const char* fmt, ...)
+{
+    char line[1024];
+    va_list ap;
+
+    // format in place when it fits the current buffer
+    size_t room = WRITER_BUF_SIZE - w->len[w->cur];
+    va_start(ap, fmt);
+    int n = vsnprintf(w->bufs[w->cur] + w->len[w->cur], room, fmt, ap);
+    va_end(ap);
+    if (n < 0)
+    {
+        return 0;
+    }
+    if ((size_t)n < room)
+    {
+        w->len[w->cur] += n;
+        return !__atomic_load_n(&w->error, __ATOMIC_RELAXED);
+    }
+
+    char* buf = (size_t)n < sizeof(line) ? line : (char*)malloc(n + 1);
+    va_start(ap, fmt);
+    vsnprintf(buf, n + 1, fmt, ap);
+    va_end(ap);
+    int ok = writer_write(w, buf, n);
+    if (buf != line)
+    {
+        free(buf);
+    }
+    return ok;
+}
+
+int writer_close(writer_t* w)
+{
+    pthread_mutex_lock(&w->lock);
+    if (w->len[w->cur] > 0 && !w->done)
+    {
+        w->full++;
+    }
+    w->done = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+
+    if (w->started)
+    {
+        pthread_join(w->thread, NULL);
+    }
+
+    int ok = !__atomic_load_n(&w->error, __ATOMIC_RELAXED);
+    if (w->owned)
+    {
+        ok = fclose(w->file) == 0 && ok;
+    }
+    else
+    {
+        ok = fflush(w->file) == 0 && ok;
+    }
+
+    for (int i = 0; i < WRITER_BUFS; i++)
+    {
+        free(w->bufs[i]);
+    }
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
+    free(w);
+    return ok;
+}
@@ -0,0 +1,44 @@
+//========================================================//
+//  writer.h                                              //
+//  Header file for the asynchronous output writer        //
+//                                                        //
+//  Buffers output and writes it from a background        //
+//  thread so the simulation never waits on the file      //
+//========================================================//
+
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stddef.h>
+
+typedef struct writer writer_t;
+
+// Open 'path' for writing, or stdout when 'path' is NULL or "-", and
+// start the writer thread
+//
+// Returns NULL on failure
+//
+writer_t* writer_open(const char* path);
+
+// Append 'len' bytes to the output. The caller only waits when every
+// buffer is full and still queued for the writer thread.
+//
+// Returns True if Successful
+//
+int writer_write(writer_t* w, const void* data, size_t len);
+
+// Append formatted text to the output
+//
+// Returns True if Successful
+//
+int writer_printf(writer_t* w, const char* fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+// Write out everything buffered, stop the writer thread and close the
+// file unless it is stdout
+//
+// Returns True if all of the output was written
+//
+int writer_close(writer_t* w);
+
+#endif